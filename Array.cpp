@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string.h>
+
+#include "Memory.cpp"
+
+// NOTE(jan): Dynamic array whose storage lives in a MemoryArena. If nothing
+// else has been allocated from the arena since the storage, it is grown in
+// place. Otherwise elements are moved with memcpy, so T must be trivially
+// copyable, and the old storage is left in the arena.
+template<typename T>
+struct Array {
+    MemoryArena* arena;
+    T* data;
+    umm count;
+    umm capacity;
+
+    T& operator[](umm i) { return data[i]; }
+    const T& operator[](umm i) const { return data[i]; }
+    T* begin() { return data; }
+    T* end() { return data + count; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+};
+
+template<typename T>
+void
+arrayReserve(Array<T>* array, umm capacity) {
+    if (capacity <= array->capacity) return;
+
+    array->data = (T*)memoryArenaResize(
+        array->arena,
+        array->data,
+        array->capacity * sizeof(T),
+        capacity * sizeof(T),
+        alignof(T)
+    );
+    array->capacity = capacity;
+}
+
+template<typename T>
+void
+arrayInit(Array<T>* array, MemoryArena* arena, umm capacity = 0) {
+    *array = {};
+    array->arena = arena;
+    arrayReserve(array, capacity);
+}
+
+template<typename T>
+Array<T>
+arrayCreate(MemoryArena* arena, umm capacity = 0) {
+    Array<T> result;
+    arrayInit(&result, arena, capacity);
+    return result;
+}
+
+// NOTE(jan): New elements are zeroed.
+template<typename T>
+void
+arrayResize(Array<T>* array, umm count) {
+    arrayReserve(array, count);
+    if (count > array->count) {
+        memset(array->data + array->count, 0, (count - array->count) * sizeof(T));
+    }
+    array->count = count;
+}
+
+// NOTE(jan): Appends a zeroed element and returns it.
+template<typename T>
+T&
+arrayPush(Array<T>* array) {
+    if (array->count == array->capacity) {
+        umm capacity = array->capacity * 2;
+        if (capacity < 8) capacity = 8;
+        arrayReserve(array, capacity);
+    }
+    T& result = array->data[array->count++];
+    memset(&result, 0, sizeof(T));
+    return result;
+}
+
+template<typename T>
+T&
+arrayPush(Array<T>* array, const T& value) {
+    T& result = arrayPush(array);
+    result = value;
+    return result;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CLOCK_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+#include "Types.h"
+
+// NOTE(jan): Monotonic time as u64 nanoseconds since the clock was created at
+// startup, which lasts for centuries without losing precision. The platform
+// counter is read by default. After clockCalibrateTsc succeeds, RDTSC is
+// read instead and scaled by the calibrated frequency.
+
+struct Clock {
+    // NOTE(jan): Of the platform counter.
+    u64 frequency;
+    u64 epoch;
+    bool useTsc;
+    u64 tscEpoch;
+    u64 tscFrequency;
+    // NOTE(jan): Nanoseconds per TSC tick in 32.32 fixed point.
+    u64 tscScale;
+};
+
+inline u64
+clockRaw() {
+#ifdef WIN32
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+#else
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (u64)t.tv_sec * 1000000000ull + (u64)t.tv_nsec;
+#endif
+}
+
+// NOTE(jan): ticks * multiplier / divisor for any ticks, as long as
+// multiplier * divisor fits in 64 bits.
+inline u64
+clockMulDiv(u64 ticks, u64 multiplier, u64 divisor) {
+    return (ticks / divisor) * multiplier + (ticks % divisor) * multiplier / divisor;
+}
+
+// NOTE(jan): (a * b) >> 32 with the full 128 bit product.
+inline u64
+clockMulShift32(u64 a, u64 b) {
+#ifdef _MSC_VER
+    u64 high;
+    u64 low = _umul128(a, b, &high);
+    return (high << 32) | (low >> 32);
+#else
+    return (u64)(((unsigned __int128)a * b) >> 32);
+#endif
+}
+
+Clock
+clockCreate() {
+    Clock result = {};
+#ifdef WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    result.frequency = frequency.QuadPart;
+#else
+    result.frequency = 1000000000;
+#endif
+    result.epoch = clockRaw();
+    return result;
+}
+
+Clock clockState = clockCreate();
+
+inline u64
+clockNow() {
+#ifdef CLOCK_TSC
+    if (clockState.useTsc) {
+        return clockMulShift32(__rdtsc() - clockState.tscEpoch, clockState.tscScale);
+    }
+#endif
+    return clockMulDiv(clockRaw() - clockState.epoch, 1000000000, clockState.frequency);
+}
+
+inline f64
+clockSeconds(u64 nanoseconds) {
+    return nanoseconds / 1e9;
+}
+
+inline f64
+clockMilliseconds(u64 nanoseconds) {
+    return nanoseconds / 1e6;
+}
+
+// NOTE(jan): Measures the TSC against the platform counter for the given
+// number of milliseconds, and switches clockNow over to it if the CPU reports
+// an invariant TSC. Call once at startup, before other threads read the clock.
+bool
+clockCalibrateTsc(u32 milliseconds = 20) {
+#ifdef CLOCK_TSC
+    u32 registers[4] = {};
+#ifdef _MSC_VER
+    __cpuid((int*)registers, 0x80000000);
+    if (registers[0] < 0x80000007) return false;
+    __cpuid((int*)registers, 0x80000007);
+#else
+    if (!__get_cpuid(0x80000007, &registers[0], &registers[1], &registers[2], &registers[3])) {
+        return false;
+    }
+#endif
+    // NOTE(jan): EDX bit 8 is set if the TSC runs at a constant rate in every
+    // power state.
+    if (!(registers[3] & (1 << 8))) return false;
+
+    u64 wait = clockMulDiv(milliseconds, clockState.frequency, 1000);
+    u64 rawStart = clockRaw();
+    u64 tscStart = __rdtsc();
+    u64 rawEnd;
+    do {
+        rawEnd = clockRaw();
+    } while (rawEnd - rawStart < wait);
+    u64 tscEnd = __rdtsc();
+
+    u64 tscFrequency = clockMulDiv(tscEnd - tscStart, clockState.frequency, rawEnd - rawStart);
+    if (tscFrequency == 0) return false;
+
+    // NOTE(jan): Carry on from the current time, so clockNow does not jump.
+    u64 now = clockMulDiv(rawEnd - clockState.epoch, 1000000000, clockState.frequency);
+    u64 scale = (1000000000ull << 32) / tscFrequency;
+    clockState.tscFrequency = tscFrequency;
+    clockState.tscScale = scale;
+    clockState.tscEpoch = tscEnd - clockMulDiv(now, tscFrequency, 1000000000);
+    clockState.useTsc = true;
+    return true;
+#else
+    return false;
+#endif
+}
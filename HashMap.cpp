@@ -0,0 +1,158 @@
+#pragma once
+
+#include <string.h>
+
+#include "Memory.cpp"
+
+// NOTE(jan): Open addressing hash map with linear probing, stored in a
+// MemoryArena. Keys and values are moved with memcpy, so both must be
+// trivially copyable.
+
+inline u64
+hashKey(u64 key) {
+    // NOTE(jan): splitmix64 finalizer.
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+inline u64 hashKey(u32 key) { return hashKey((u64)key); }
+inline u64 hashKey(s32 key) { return hashKey((u64)(u32)key); }
+inline u64 hashKey(s64 key) { return hashKey((u64)key); }
+inline u64 hashKey(const void* key) { return hashKey((u64)(umm)key); }
+
+// NOTE(jan): For string and other byte keys. Mixes in 8 bytes at a time and
+// finishes with the finalizer above.
+inline u64
+hashBytes(const void* data, umm length) {
+    const u8* bytes = (const u8*)data;
+    u64 result = 0x9e3779b97f4a7c15ull ^ length;
+    while (length >= 8) {
+        u64 word;
+        memcpy(&word, bytes, 8);
+        result = (result ^ word) * 0xff51afd7ed558ccdull;
+        result ^= result >> 32;
+        bytes += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        u64 word = 0;
+        memcpy(&word, bytes, length);
+        result = (result ^ word) * 0xff51afd7ed558ccdull;
+    }
+    return hashKey(result);
+}
+
+template<typename K, typename V>
+struct HashMap {
+    MemoryArena* arena;
+    K* keys;
+    V* values;
+    bool* used;
+    umm count;
+    umm capacity;
+};
+
+template<typename K, typename V>
+void
+hashMapAllocate(HashMap<K, V>* map, umm capacity) {
+    map->keys = memoryArenaAllocateArray(map->arena, K, capacity);
+    map->values = memoryArenaAllocateArray(map->arena, V, capacity);
+    map->used = memoryArenaAllocateArray(map->arena, bool, capacity);
+    memset(map->used, 0, capacity * sizeof(bool));
+    map->capacity = capacity;
+    map->count = 0;
+}
+
+// NOTE(jan): The capacity is rounded up to a power of two.
+template<typename K, typename V>
+void
+hashMapInit(HashMap<K, V>* map, MemoryArena* arena, umm capacity = 16) {
+    *map = {};
+    map->arena = arena;
+    umm size = 16;
+    while (size < capacity) size *= 2;
+    hashMapAllocate(map, size);
+}
+
+template<typename K, typename V>
+umm
+hashMapFind(HashMap<K, V>* map, K key) {
+    umm mask = map->capacity - 1;
+    umm index = hashKey(key) & mask;
+    while (map->used[index] && !(map->keys[index] == key)) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+template<typename K, typename V>
+V*
+hashMapGet(HashMap<K, V>* map, K key) {
+    umm index = hashMapFind(map, key);
+    return map->used[index] ? &map->values[index] : nullptr;
+}
+
+template<typename K, typename V>
+V*
+hashMapPut(HashMap<K, V>* map, K key, V value);
+
+template<typename K, typename V>
+void
+hashMapGrow(HashMap<K, V>* map) {
+    HashMap<K, V> old = *map;
+    hashMapAllocate(map, old.capacity * 2);
+    for (umm i = 0; i < old.capacity; i++) {
+        if (old.used[i]) {
+            hashMapPut(map, old.keys[i], old.values[i]);
+        }
+    }
+}
+
+// NOTE(jan): Inserts or overwrites, and returns the stored value.
+template<typename K, typename V>
+V*
+hashMapPut(HashMap<K, V>* map, K key, V value) {
+    // NOTE(jan): Keep the load factor under 3/4.
+    if ((map->count + 1) * 4 > map->capacity * 3) {
+        hashMapGrow(map);
+    }
+
+    umm index = hashMapFind(map, key);
+    if (!map->used[index]) {
+        map->used[index] = true;
+        map->keys[index] = key;
+        map->count++;
+    }
+    map->values[index] = value;
+    return &map->values[index];
+}
+
+// NOTE(jan): Backward shift deletion, so no tombstones are needed.
+template<typename K, typename V>
+bool
+hashMapRemove(HashMap<K, V>* map, K key) {
+    umm mask = map->capacity - 1;
+    umm index = hashMapFind(map, key);
+    if (!map->used[index]) return false;
+
+    umm hole = index;
+    umm next = (hole + 1) & mask;
+    while (map->used[next]) {
+        umm home = hashKey(map->keys[next]) & mask;
+        // NOTE(jan): Move the entry into the hole unless its home slot lies
+        // cyclically between the hole and its current position.
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            map->values[hole] = map->values[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    map->used[hole] = false;
+    map->count--;
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mutex>
+#include <string.h>
+
+#include "HashMap.cpp"
+#include "Memory.cpp"
+
+// NOTE(jan): Stores each distinct string once, so that interned strings can
+// be compared by pointer and used as HashMap keys. Interned strings are NUL
+// terminated and stay valid until the table is cleared. Every call takes the
+// table's lock, so it can be filled from several threads at startup.
+
+struct InternEntry {
+    u64 hash;
+    const char* string;
+    umm length;
+};
+
+struct InternTable {
+    MemoryArena arena;
+    std::mutex lock;
+    InternEntry* entries;
+    umm count;
+    umm capacity;
+};
+
+InternTable internTable;
+
+InternEntry*
+internFindEntry(InternTable* table, u64 hash, const char* s, umm length) {
+    umm mask = table->capacity - 1;
+    umm index = hash & mask;
+    while (true) {
+        InternEntry* entry = &table->entries[index];
+        if (entry->string == nullptr) return entry;
+        if (entry->hash == hash && entry->length == length &&
+                memcmp(entry->string, s, length) == 0) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+void
+internGrow(InternTable* table) {
+    InternEntry* entries = table->entries;
+    umm capacity = table->capacity;
+
+    table->capacity = capacity ? capacity * 2 : 256;
+    table->entries = memoryArenaAllocateArray(&table->arena, InternEntry, table->capacity);
+    memset(table->entries, 0, table->capacity * sizeof(InternEntry));
+
+    // NOTE(jan): The old entries are left in the arena.
+    for (umm i = 0; i < capacity; i++) {
+        InternEntry& entry = entries[i];
+        if (entry.string == nullptr) continue;
+        *internFindEntry(table, entry.hash, entry.string, entry.length) = entry;
+    }
+}
+
+const char*
+intern(InternTable* table, const char* s, umm length) {
+    u64 hash = hashBytes(s, length);
+    std::lock_guard<std::mutex> guard(table->lock);
+
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        internGrow(table);
+    }
+
+    InternEntry* entry = internFindEntry(table, hash, s, length);
+    if (entry->string == nullptr) {
+        char* copy = (char*)memoryArenaAllocate(&table->arena, length + 1);
+        memcpy(copy, s, length);
+        copy[length] = '\0';
+
+        entry->hash = hash;
+        entry->string = copy;
+        entry->length = length;
+        table->count++;
+    }
+    return entry->string;
+}
+
+const char*
+intern(InternTable* table, const char* s) {
+    return intern(table, s, strlen(s));
+}
+
+// NOTE(jan): Like intern, but returns nullptr instead of adding the string.
+const char*
+internFind(InternTable* table, const char* s) {
+    umm length = strlen(s);
+    u64 hash = hashBytes(s, length);
+    std::lock_guard<std::mutex> guard(table->lock);
+
+    if (table->capacity == 0) return nullptr;
+    return internFindEntry(table, hash, s, length)->string;
+}
+
+void
+internClear(InternTable* table) {
+    std::lock_guard<std::mutex> guard(table->lock);
+    memoryArenaClear(&table->arena);
+    table->entries = nullptr;
+    table->count = 0;
+    table->capacity = 0;
+}
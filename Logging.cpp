@@ -1,41 +1,109 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <mutex>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 
+#ifdef WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
+#include "Clock.cpp"
 #include "Types.h"
 
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERR 3
+#define LOG_LEVEL_FATAL 4
+
 // ******************
 // * Counter stuff. *
 // ******************
 
+static FILE* logFile;
+
+#ifdef WIN32
+// NOTE(jan): Deprecated, use clockNow. Platform layers used to set these at
+// startup for getElapsed, which still honours them once they are set, so that
+// code keeps building and its times keep their old epoch. clockState starts
+// itself and does not read them; to restart it, clockState = clockCreate().
 LARGE_INTEGER counterEpoch;
 LARGE_INTEGER counterFrequency;
-static FILE* logFile;
+#endif
 
-float getElapsed() {
-    LARGE_INTEGER t;
-    QueryPerformanceCounter(&t);
-    auto result =
-        (t.QuadPart - counterEpoch.QuadPart)
-        / (float)counterFrequency.QuadPart;
-    return result;
+// NOTE(jan): Seconds since startup. Prefer clockNow, which does not lose
+// precision over long sessions.
+f64 getElapsed() {
+#ifdef WIN32
+    if (counterFrequency.QuadPart) {
+        LARGE_INTEGER t;
+        QueryPerformanceCounter(&t);
+        return (t.QuadPart - counterEpoch.QuadPart) / (f64)counterFrequency.QuadPart;
+    }
+#endif
+    return clockSeconds(clockNow());
 }
 
 // ******************
 // * Console stuff. *
 // ******************
 
+struct MemoryArena;
+void* memoryArenaAllocateAligned(MemoryArena* arena, umm size, umm alignment);
+
 struct ConsoleLine {
-    // NOTE(jan): Relative to Console::bytesRead
+    // NOTE(jan): Offset of the first byte in Console::data.
     umm start;
     umm size;
+    // NOTE(jan): Console::bytesRead before the line was written. The text
+    // has been overwritten once bytesRead is more than Console::size past it.
+    umm position;
+    // NOTE(jan): Bloom filter of the case folded trigrams in the text.
+    u64 trigrams[2];
+    u16 fileId;
+    u8 level;
+};
+
+// NOTE(jan): Blocks summarize consecutive slots in LineBuffer::data, and
+// groups consecutive blocks, so that a search can skip a whole block or group
+// without a level, file or trigram it wants. A summary is reset when its first
+// slot is reused, so the block and group holding the newest line can also
+// hold older lines they do not cover, and are never skipped.
+const umm CONSOLE_LINE_BLOCK_SIZE = 64;
+const umm CONSOLE_LINE_GROUP_SIZE = 64 * CONSOLE_LINE_BLOCK_SIZE;
+
+struct ConsoleLineBlock {
+    // NOTE(jan): Bit fileId % 64 of each line.
+    u64 files;
+    // NOTE(jan): Bit level of each line.
+    u32 levels;
+    u64 trigrams[16];
+};
+
+struct ConsoleLineGroup {
+    u64 files;
+    u32 levels;
+    u64 trigrams[128];
 };
 
 #define MAX_SCROLLBACK_LINES 1024
 struct LineBuffer {
-    ConsoleLine data[MAX_SCROLLBACK_LINES];
+    ConsoleLine* data;
+    ConsoleLineBlock* blocks;
+    ConsoleLineGroup* groups;
     umm first;
     umm next;
     umm count;
@@ -53,16 +121,34 @@ struct Console {
     bool show;
 };
 
+// NOTE(jan): File names seen by the console. ID 0 is for lines without one.
+const u32 CONSOLE_MAX_FILES = 1024;
+
+struct ConsoleFiles {
+    const char* names[CONSOLE_MAX_FILES];
+    u32 count = 1;
+};
+
+ConsoleFiles consoleFiles;
+
 Console console;
 
+// NOTE(jan): Guards console and consoleFiles. Lines are formatted straight
+// into the ring, so loggers hold it from formatting until the line has been
+// handed to the writer. Take it to read the console from another thread.
+std::mutex consoleLock;
+
 #ifndef isPowerOfTwo
 #define isPowerOfTwo(x) (((x) & ((x) - 1)) == 0)
 #endif
 
+// NOTE(jan): The scrollback holds maxLines lines, rounded up to a multiple of
+// CONSOLE_LINE_BLOCK_SIZE, allocated from arena or the C heap if it is null.
 // Derived from https://github.com/cmuratori/refterm/blob/main/refterm_example_source_buffer.c
-Console initConsole(size_t bufferSize) {
+Console initConsole(size_t bufferSize, MemoryArena* arena = nullptr, umm maxLines = MAX_SCROLLBACK_LINES) {
     Console result = {};
 
+#ifdef WIN32
     SYSTEM_INFO info;
     GetSystemInfo(&info);
     if (!isPowerOfTwo(info.dwAllocationGranularity)) {
@@ -107,50 +193,736 @@ Console initConsole(size_t bufferSize) {
         exit(3);
     }
 
+#else
+    umm pageSize = sysconf(_SC_PAGESIZE);
+    bufferSize = ((bufferSize / pageSize) + 1) * pageSize;
+
+#ifdef __linux__
+    int section = memfd_create("console", 0);
+#else
+    char name[64];
+    snprintf(name, sizeof(name), "/console-%d", (int)getpid());
+    int section = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (section >= 0) shm_unlink(name);
+#endif
+    if (section < 0 || ftruncate(section, bufferSize) != 0) {
+        fprintf(stderr, "could not create ringbuffer section");
+        exit(3);
+    }
+
+    // NOTE(jan): Reserve room for both views, then map the section twice over
+    // the reservation, so nothing else can be mapped in between.
+    void* ringBuffer = nullptr;
+    u8* range = (u8*)mmap(NULL, 2 * bufferSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (range != MAP_FAILED) {
+        void* view1 = mmap(range, bufferSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, section, 0);
+        void* view2 = mmap(range + bufferSize, bufferSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, section, 0);
+        if (view1 != MAP_FAILED && view2 != MAP_FAILED) {
+            ringBuffer = range;
+        } else {
+            munmap(range, 2 * bufferSize);
+        }
+    }
+    close(section);
+
+    if (!ringBuffer) {
+        fprintf(stderr, "could not allocate ringbuffer");
+        exit(3);
+    }
+#endif
+
     result.data = ringBuffer;
     result.size = bufferSize;
     result.top = 0;
     result.bottom = 0;
-    result.lines.max = MAX_SCROLLBACK_LINES;
+
+    maxLines = (maxLines + CONSOLE_LINE_BLOCK_SIZE - 1) / CONSOLE_LINE_BLOCK_SIZE * CONSOLE_LINE_BLOCK_SIZE;
+    if (maxLines == 0) maxLines = CONSOLE_LINE_BLOCK_SIZE;
+    umm blockCount = maxLines / CONSOLE_LINE_BLOCK_SIZE;
+    umm groupCount = (maxLines + CONSOLE_LINE_GROUP_SIZE - 1) / CONSOLE_LINE_GROUP_SIZE;
+    umm linesSize = maxLines * sizeof(ConsoleLine);
+    umm blocksSize = blockCount * sizeof(ConsoleLineBlock);
+    umm groupsSize = groupCount * sizeof(ConsoleLineGroup);
+    if (arena) {
+        result.lines.data = (ConsoleLine*)memoryArenaAllocateAligned(arena, linesSize, alignof(ConsoleLine));
+        result.lines.blocks = (ConsoleLineBlock*)memoryArenaAllocateAligned(arena, blocksSize, alignof(ConsoleLineBlock));
+        result.lines.groups = (ConsoleLineGroup*)memoryArenaAllocateAligned(arena, groupsSize, alignof(ConsoleLineGroup));
+    } else {
+        result.lines.data = (ConsoleLine*)malloc(linesSize);
+        result.lines.blocks = (ConsoleLineBlock*)malloc(blocksSize);
+        result.lines.groups = (ConsoleLineGroup*)malloc(groupsSize);
+    }
+    if (!result.lines.data || !result.lines.blocks || !result.lines.groups) {
+        fprintf(stderr, "could not allocate scrollback");
+        exit(3);
+    }
+    memset(result.lines.data, 0, linesSize);
+    memset(result.lines.blocks, 0, blocksSize);
+    memset(result.lines.groups, 0, groupsSize);
+    result.lines.max = maxLines;
     return result;
 }
 
+// NOTE(jan): Call with consoleLock held.
+u16
+consoleFileId(const char* fileName) {
+    if (!fileName) return 0;
+    // NOTE(jan): __FILE__ is usually the same pointer every time.
+    for (u32 i = 1; i < consoleFiles.count; i++) {
+        if (consoleFiles.names[i] == fileName) return i;
+    }
+    for (u32 i = 1; i < consoleFiles.count; i++) {
+        if (strcmp(consoleFiles.names[i], fileName) == 0) return i;
+    }
+    if (consoleFiles.count == CONSOLE_MAX_FILES) return 0;
+    consoleFiles.names[consoleFiles.count] = fileName;
+    return consoleFiles.count++;
+}
+
+inline u8
+consoleFold(u8 c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// NOTE(jan): Sets the bit for each case folded trigram of text in the bloom
+// filters of a line, 128 bits, a block, 1024 bits, and a group, 8192 bits.
+// Each takes different bits of the hash.
+void
+consoleTrigrams(const char* text, umm length, u64* line, u64* block, u64* group) {
+    if (length < 3) return;
+    u8 a = consoleFold(text[0]);
+    u8 b = consoleFold(text[1]);
+    for (umm i = 2; i < length; i++) {
+        u8 c = consoleFold(text[i]);
+        u32 hash = (((u32)a << 16) | ((u32)b << 8) | c) * 0x9e3779b1u;
+        u32 lineBit = hash >> 25;
+        line[lineBit >> 6] |= 1ull << (lineBit & 63);
+        u32 blockBit = (hash >> 15) & 1023;
+        block[blockBit >> 6] |= 1ull << (blockBit & 63);
+        u32 groupBit = (hash >> 2) & 8191;
+        group[groupBit >> 6] |= 1ull << (groupBit & 63);
+        a = b;
+        b = c;
+    }
+}
+
+template<typename Summary>
+inline void
+consoleSummaryAdd(Summary& summary, ConsoleLine& line) {
+    summary.files |= 1ull << (line.fileId % 64);
+    summary.levels |= 1u << line.level;
+}
+
+// NOTE(jan): The line's text must already be at line.start. Its trigrams are
+// indexed here.
 void
 consolePushLine(Console& console, ConsoleLine& line) {
     LineBuffer& lines = console.lines;
-    lines.data[lines.next] = line;
+    umm slot = lines.next;
+
+    ConsoleLineBlock& block = lines.blocks[slot / CONSOLE_LINE_BLOCK_SIZE];
+    ConsoleLineGroup& group = lines.groups[slot / CONSOLE_LINE_GROUP_SIZE];
+    if (slot % CONSOLE_LINE_BLOCK_SIZE == 0) block = {};
+    if (slot % CONSOLE_LINE_GROUP_SIZE == 0) group = {};
+
+    line.trigrams[0] = 0;
+    line.trigrams[1] = 0;
+    consoleTrigrams((const char*)console.data + line.start, line.size, line.trigrams, block.trigrams, group.trigrams);
+    consoleSummaryAdd(block, line);
+    consoleSummaryAdd(group, line);
+    lines.data[slot] = line;
+
     lines.next = (lines.next + 1) % lines.max;
     lines.first = lines.count < lines.max ? 0 : lines.next + 1;
-    lines.count = min(lines.max, lines.count + 1);
+    lines.count = lines.count < lines.max ? lines.count + 1 : lines.max;
+}
+
+// **********************
+// * Mapped file stuff. *
+// **********************
+
+// NOTE(jan): With logMapOpen, the log file is mapped into memory and lines
+// are copied into it with plain stores rather than written and flushed one by
+// one. The OS writes the pages out even if the process is killed, and they are
+// synced every syncIntervalMs in case the machine goes down. A file that was
+// not closed is zero past the end of its text, and the header records how
+// much of it was committed.
+
+const char LOG_FILE_MAGIC[8] = {'L', 'O', 'G', 'M', 'A', 'P', '1', '\n'};
+
+struct LogFileHeader {
+    char magic[8];
+    // NOTE(jan): Bytes of text after the header. Stored after the text, so it
+    // never covers text that is not there yet.
+    std::atomic<u64> committed;
+    // NOTE(jan): Spaces ending in a newline, so the text starts on a line of
+    // its own in an editor.
+    char padding[48];
+};
+
+struct LogMappedFile {
+#ifdef WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+    u8* view;
+    // NOTE(jan): Of the file and the view, header included.
+    umm size;
+    LogFileHeader* header;
+    u64 syncInterval;
+    u64 lastSync;
+    bool open;
+};
+
+LogMappedFile logMap;
+// NOTE(jan): Held while text is copied in and while the view is remapped to
+// grow it. Synchronous loggers are already serialised by consoleLock, but
+// the writer thread is not, and a line may still be on its way in when
+// logWriterStart hands over to it.
+std::mutex logMapLock;
+
+bool
+logMapView(umm size) {
+#ifdef WIN32
+    // NOTE(jan): Creating the mapping grows the file to size.
+    logMap.mapping = CreateFileMappingA(
+        logMap.file, NULL, PAGE_READWRITE, (DWORD)((u64)size >> 32), (DWORD)size, NULL
+    );
+    if (logMap.mapping == NULL) return false;
+    logMap.view = (u8*)MapViewOfFile(logMap.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (logMap.view == NULL) {
+        CloseHandle(logMap.mapping);
+        return false;
+    }
+#else
+    if (ftruncate(logMap.file, size) != 0) return false;
+    void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, logMap.file, 0);
+    if (view == MAP_FAILED) return false;
+    logMap.view = (u8*)view;
+#endif
+    logMap.size = size;
+    logMap.header = (LogFileHeader*)logMap.view;
+    return true;
+}
+
+void
+logMapUnview() {
+#ifdef WIN32
+    UnmapViewOfFile(logMap.view);
+    CloseHandle(logMap.mapping);
+#else
+    munmap(logMap.view, logMap.size);
+#endif
+    logMap.view = nullptr;
+    logMap.header = nullptr;
+}
+
+// NOTE(jan): Starts the write back of everything committed, and with wait set,
+// blocks until it is on disk.
+void
+logMapSync(bool wait) {
+#ifdef WIN32
+    FlushViewOfFile(logMap.view, 0);
+    if (wait) FlushFileBuffers(logMap.file);
+#else
+    msync(logMap.view, logMap.size, wait ? MS_SYNC : MS_ASYNC);
+#endif
+    logMap.lastSync = clockNow();
+}
+
+// NOTE(jan): Replaces any file at path. The file starts out with room for
+// capacity bytes of text and doubles whenever it fills up. Returns false if
+// the file could not be created or mapped. Whether it is open is checked
+// without logMapLock, so open it before other threads log and close it after.
+bool
+logMapOpen(const char* path, umm capacity = 64 * 1024 * 1024, u32 syncIntervalMs = 1000) {
+    logMap = {};
+#ifdef WIN32
+    logMap.file = CreateFileA(
+        path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (logMap.file == INVALID_HANDLE_VALUE) return false;
+#else
+    logMap.file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (logMap.file < 0) return false;
+#endif
+
+    if (!logMapView(sizeof(LogFileHeader) + capacity)) {
+#ifdef WIN32
+        CloseHandle(logMap.file);
+#else
+        close(logMap.file);
+#endif
+        return false;
+    }
+
+    LogFileHeader* header = logMap.header;
+    memcpy(header->magic, LOG_FILE_MAGIC, sizeof(header->magic));
+    memset(header->padding, ' ', sizeof(header->padding));
+    header->padding[sizeof(header->padding) - 1] = '\n';
+    header->committed.store(0, std::memory_order_release);
+
+    logMap.syncInterval = (u64)syncIntervalMs * 1000000;
+    logMap.lastSync = clockNow();
+    logMap.open = true;
+    return true;
+}
+
+void
+logMapWrite(const void* data, umm length) {
+    std::lock_guard<std::mutex> guard(logMapLock);
+    u64 committed = logMap.header->committed.load(std::memory_order_relaxed);
+    umm needed = sizeof(LogFileHeader) + committed + length;
+    if (needed > logMap.size) {
+        umm size = logMap.size * 2;
+        while (size < needed) size *= 2;
+        logMapUnview();
+        if (!logMapView(size)) {
+            fprintf(stderr, "could not grow mapped log file");
+            exit(5);
+        }
+    }
+
+    memcpy(logMap.view + sizeof(LogFileHeader) + committed, data, length);
+    logMap.header->committed.store(committed + length, std::memory_order_release);
+
+    if (clockNow() - logMap.lastSync >= logMap.syncInterval) logMapSync(false);
+}
+
+// NOTE(jan): Syncs the file and cuts it down to the text that was written.
+void
+logMapClose() {
+    std::lock_guard<std::mutex> guard(logMapLock);
+    if (!logMap.open) return;
+    logMapSync(true);
+    umm size = sizeof(LogFileHeader) + logMap.header->committed.load(std::memory_order_acquire);
+    logMapUnview();
+#ifdef WIN32
+    LARGE_INTEGER end;
+    end.QuadPart = size;
+    SetFilePointerEx(logMap.file, end, NULL, FILE_BEGIN);
+    SetEndOfFile(logMap.file);
+    CloseHandle(logMap.file);
+#else
+    if (ftruncate(logMap.file, size) != 0) {
+        fprintf(stderr, "could not truncate mapped log file");
+    }
+    close(logMap.file);
+#endif
+    logMap.open = false;
+}
+
+// NOTE(jan): Log output goes to the mapped file if one is open, and to file
+// otherwise.
+inline void
+logFileWrite(FILE* file, const void* data, umm length) {
+    if (logMap.open) {
+        logMapWrite(data, length);
+    } else {
+        fwrite(data, 1, length, file);
+    }
+}
+
+// NOTE(jan): The mapped file needs no flush, since its pages are already the
+// file's; it is only synced on its interval.
+inline void
+logFileFlush(FILE* file) {
+    if (!logMap.open && file) fflush(file);
+}
+
+// *****************
+// * Writer stuff. *
+// *****************
+
+// NOTE(jan): Once logWriterStart has been called, log lines are copied into a
+// lock-free ring by the threads that log them and written to the log file in
+// batches by a background thread. Until then, or after logWriterStop, lines
+// are written and flushed on the calling thread.
+
+enum LogOverflowPolicy {
+    // NOTE(jan): Lines that do not fit in the ring are dropped, and the writer
+    // reports how many were lost.
+    LOG_OVERFLOW_DROP,
+    // NOTE(jan): Loggers wait for the writer to make room.
+    LOG_OVERFLOW_BLOCK,
+};
+
+struct LogWriterConfig {
+    // NOTE(jan): Rounded up to a power of two.
+    umm ringSize = 1024 * 1024;
+    // NOTE(jan): Lines are in the file at most this long after being logged.
+    u32 flushIntervalMs = 100;
+    LogOverflowPolicy overflow = LOG_OVERFLOW_DROP;
+};
+
+// NOTE(jan): Records are 8 byte aligned and never wrap around the end of the
+// ring; a padding record fills the gap instead. size is zero until the record
+// has been written, and covers the header, the text and the alignment.
+struct LogRecordHeader {
+    std::atomic<u32> size;
+    u32 length;
+};
+
+const u32 LOG_RECORD_PADDING = 0xffffffff;
+// NOTE(jan): Set in length for a LogBinaryRecord rather than text.
+const u32 LOG_RECORD_BINARY = 0x80000000;
+const umm LOG_BATCH_SIZE = 64 * 1024;
+
+struct LogBinaryRecord;
+typedef umm LogRenderFunction(const LogBinaryRecord* record, char* out, umm size);
+
+// NOTE(jan): Followed by the arguments of the log call, which render reads
+// back to format the message.
+struct LogBinaryRecord {
+    const char* level;
+    const char* fileName;
+    const char* fmt;
+    LogRenderFunction* render;
+    u64 nanoseconds;
+    s32 lineNumber;
+};
+
+// NOTE(jan): Longest line a binary record renders to; the rest is cut off.
+const umm LOG_MAX_LINE = 4096;
+
+struct LogWriter {
+    LogWriterConfig config;
+    FILE* file;
+    u8* ring;
+    umm size;
+    // NOTE(jan): Byte counts since the start. Loggers advance reserved, the
+    // writer advances released as it copies records out, and written once
+    // they have been flushed to the file.
+    std::atomic<u64> reserved;
+    std::atomic<u64> released;
+    std::atomic<u64> written;
+    std::atomic<u64> dropped;
+    std::atomic<bool> running;
+    std::atomic<bool> woken;
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    u64 flushTarget;
+    bool stopping;
+    u8* batch;
+};
+
+LogWriter logWriter;
+
+void
+logWriterWake() {
+    if (logWriter.woken.exchange(true, std::memory_order_acq_rel)) return;
+    std::lock_guard<std::mutex> guard(logWriter.lock);
+    logWriter.wake.notify_one();
+}
+
+// NOTE(jan): Writes at most LOG_MAX_LINE bytes to out, not NUL terminated.
+umm
+logRenderBinary(const LogBinaryRecord* record, char* out) {
+    // NOTE(jan): snprintf needs room for the NUL.
+    char line[LOG_MAX_LINE + 1];
+    const char* prefixFmt = "[%s] [%f] [%s:%d] ";
+    int written = snprintf(line, sizeof(line), prefixFmt, record->level,
+        clockSeconds(record->nanoseconds), record->fileName, record->lineNumber);
+    umm length = written < 0 ? 0 : written;
+    if (length > LOG_MAX_LINE - 1) length = LOG_MAX_LINE - 1;
+    umm message = record->render(record, line + length, LOG_MAX_LINE - length);
+    length += message;
+    if (length > LOG_MAX_LINE - 1) length = LOG_MAX_LINE - 1;
+    line[length++] = '\n';
+    memcpy(out, line, length);
+    return length;
+}
+
+// NOTE(jan): Copies out every record that is ready, up to the first one that
+// is still being written, and zeroes the space so that it reads as not ready
+// when it is reserved again.
+void
+logWriterDrain() {
+    u64 read = logWriter.released.load(std::memory_order_relaxed);
+    umm batchUsed = 0;
+
+    while (true) {
+        u8* at = logWriter.ring + (read & (logWriter.size - 1));
+        LogRecordHeader* header = (LogRecordHeader*)at;
+        u32 size = header->size.load(std::memory_order_acquire);
+        if (size == 0) break;
+
+        if (header->length == LOG_RECORD_PADDING) {
+        } else if (header->length & LOG_RECORD_BINARY) {
+            if (batchUsed + LOG_MAX_LINE > LOG_BATCH_SIZE) {
+                logFileWrite(logWriter.file, logWriter.batch, batchUsed);
+                batchUsed = 0;
+            }
+            batchUsed += logRenderBinary(
+                (const LogBinaryRecord*)(header + 1),
+                (char*)logWriter.batch + batchUsed
+            );
+        } else {
+            if (batchUsed + header->length > LOG_BATCH_SIZE) {
+                logFileWrite(logWriter.file, logWriter.batch, batchUsed);
+                batchUsed = 0;
+            }
+            memcpy(logWriter.batch + batchUsed, at + sizeof(LogRecordHeader), header->length);
+            batchUsed += header->length;
+        }
+
+        memset(at, 0, size);
+        read += size;
+        logWriter.released.store(read, std::memory_order_release);
+    }
+
+    if (batchUsed) logFileWrite(logWriter.file, logWriter.batch, batchUsed);
+    u64 dropped = logWriter.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        char line[256];
+        int length = snprintf(line, sizeof(line), "[WARN] [%f] [%s:%d] dropped %llu log lines\n",
+                getElapsed(), __FILE__, __LINE__, (unsigned long long)dropped);
+        logFileWrite(logWriter.file, line, length);
+    }
+    logFileFlush(logWriter.file);
+
+    std::lock_guard<std::mutex> guard(logWriter.lock);
+    logWriter.written.store(read, std::memory_order_release);
+    logWriter.flushed.notify_all();
+}
+
+void
+logWriterRun() {
+    auto interval = std::chrono::milliseconds(logWriter.config.flushIntervalMs);
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> guard(logWriter.lock);
+            logWriter.wake.wait_for(guard, interval, [] {
+                return logWriter.woken.load() || logWriter.stopping ||
+                    logWriter.flushTarget > logWriter.written.load();
+            });
+            logWriter.woken.store(false);
+            stopping = logWriter.stopping;
+        }
+
+        logWriterDrain();
+
+        u64 reserved = logWriter.reserved.load(std::memory_order_acquire);
+        u64 released = logWriter.released.load(std::memory_order_relaxed);
+        if (released < reserved) {
+            // NOTE(jan): A logger is part way through a record.
+            std::this_thread::yield();
+        } else if (stopping) {
+            break;
+        }
+    }
+}
+
+// NOTE(jan): file is ignored, and may be nullptr, while a mapped file is open.
+void
+logWriterStart(FILE* file, LogWriterConfig config = {}) {
+    umm size = 4096;
+    while (size < config.ringSize) size *= 2;
+
+    logWriter.config = config;
+    logWriter.file = file;
+    logWriter.size = size;
+    logWriter.ring = (u8*)calloc(size, 1);
+    logWriter.batch = (u8*)malloc(LOG_BATCH_SIZE);
+    if (!logWriter.ring || !logWriter.batch) {
+        fprintf(stderr, "could not allocate log ring");
+        exit(5);
+    }
+    logWriter.reserved.store(0);
+    logWriter.released.store(0);
+    logWriter.written.store(0);
+    logWriter.dropped.store(0);
+    logWriter.woken.store(false);
+    logWriter.flushTarget = 0;
+    logWriter.stopping = false;
+    logWriter.thread = std::thread(logWriterRun);
+    logWriter.running.store(true, std::memory_order_release);
+}
+
+// NOTE(jan): Writes out everything logged so far and goes back to writing on
+// the calling thread. No other thread may be logging while this runs.
+void
+logWriterStop() {
+    if (!logWriter.running.exchange(false, std::memory_order_acq_rel)) return;
+    {
+        std::lock_guard<std::mutex> guard(logWriter.lock);
+        logWriter.stopping = true;
+        logWriter.wake.notify_one();
+    }
+    logWriter.thread.join();
+    free(logWriter.ring);
+    free(logWriter.batch);
+    logWriter.ring = nullptr;
+    logWriter.batch = nullptr;
+}
+
+// NOTE(jan): Blocks until every line logged before the call is in the file.
+void
+logFlush() {
+    if (!logWriter.running.load(std::memory_order_acquire)) {
+        logFileFlush(logFile);
+        return;
+    }
+    u64 target = logWriter.reserved.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> guard(logWriter.lock);
+    if (target > logWriter.flushTarget) logWriter.flushTarget = target;
+    logWriter.wake.notify_one();
+    logWriter.flushed.wait(guard, [target] {
+        return logWriter.written.load() >= target;
+    });
+}
+
+// NOTE(jan): Returns space for a record with length bytes after the header,
+// or nullptr if it was dropped. The record must be finished with
+// logWriterCommit.
+LogRecordHeader*
+logWriterReserve(umm length) {
+    const umm alignment = sizeof(LogRecordHeader);
+    umm size = (sizeof(LogRecordHeader) + length + alignment - 1) & ~(alignment - 1);
+
+    u64 head = logWriter.reserved.load(std::memory_order_relaxed);
+    umm padding;
+    u64 end;
+    while (true) {
+        umm offset = head & (logWriter.size - 1);
+        padding = offset + size > logWriter.size ? logWriter.size - offset : 0;
+        end = head + padding + size;
+        if (end - logWriter.released.load(std::memory_order_acquire) > logWriter.size) {
+            if (logWriter.config.overflow == LOG_OVERFLOW_DROP) {
+                logWriter.dropped.fetch_add(1, std::memory_order_relaxed);
+                logWriterWake();
+                return nullptr;
+            }
+            logWriterWake();
+            std::this_thread::yield();
+            head = logWriter.reserved.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (logWriter.reserved.compare_exchange_weak(
+                head, end, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (padding) {
+        LogRecordHeader* header = (LogRecordHeader*)(logWriter.ring + (head & (logWriter.size - 1)));
+        header->length = LOG_RECORD_PADDING;
+        header->size.store((u32)padding, std::memory_order_release);
+        head += padding;
+    }
+
+    // NOTE(jan): Past half full, don't wait for the flush interval.
+    if (end - logWriter.released.load(std::memory_order_relaxed) > logWriter.size / 2) {
+        logWriterWake();
+    }
+
+    return (LogRecordHeader*)(logWriter.ring + (head & (logWriter.size - 1)));
+}
+
+// NOTE(jan): length may have LOG_RECORD_BINARY set.
+void
+logWriterCommit(LogRecordHeader* header, u32 length) {
+    const umm alignment = sizeof(LogRecordHeader);
+    umm size = (sizeof(LogRecordHeader) + (length & ~LOG_RECORD_BINARY) + alignment - 1) & ~(alignment - 1);
+    header->length = length;
+    header->size.store((u32)size, std::memory_order_release);
+}
+
+// NOTE(jan): The largest record that fits in the ring.
+inline umm
+logWriterMaxLength() {
+    return logWriter.size / 4;
+}
+
+void
+logWriterPush(const char* text, umm length) {
+    if (length > logWriterMaxLength()) length = logWriterMaxLength();
+    LogRecordHeader* header = logWriterReserve(length);
+    if (!header) return;
+    memcpy((u8*)(header + 1), text, length);
+    logWriterCommit(header, (u32)length);
+}
+
+// NOTE(jan): text is a line that has already been formatted into the console.
+void
+logWrite(const char* text, umm length) {
+    if (logWriter.running.load(std::memory_order_acquire)) {
+        logWriterPush(text, length);
+    } else {
+        logFileWrite(logFile, text, length);
+        logFileFlush(logFile);
+    }
+}
+
+// NOTE(jan): Stops the writer and closes whichever log file is open.
+void
+logClose() {
+    logWriterStop();
+    logMapClose();
+    if (logFile) {
+        fclose(logFile);
+        logFile = nullptr;
+    }
 }
 
 // ******************
 // * Logging stuff. *
 // ******************
 
+// NOTE(jan): Levels are passed to log() by name, which may be any of the
+// LOG_* macro names or the longer names used for Vulkan messages.
+u8
+logLevelFromName(const char* level) {
+    switch (level[0]) {
+        case 'D': return LOG_LEVEL_DEBUG;
+        case 'W': return LOG_LEVEL_WARN;
+        case 'E': return LOG_LEVEL_ERR;
+        case 'F': return LOG_LEVEL_FATAL;
+        default: return LOG_LEVEL_INFO;
+    }
+}
+
+// NOTE(jan): Lines are formatted once, straight into the console ring. The
+// ring is mapped twice back to back, so the line is contiguous there even if
+// it wraps, and is handed to logWrite from there. Both take consoleLock, so
+// lines from different threads never interleave.
 void logRaw(const char* s) {
+    std::lock_guard<std::mutex> guard(consoleLock);
     char* consoleEnd = (char*)console.data + console.bottom;
-    fprintf(logFile, "%s", s);
     int written = sprintf(consoleEnd, "%s", s);
 
     ConsoleLine line;
     line.start = console.bottom;
     line.size = written;
+    line.position = console.bytesRead;
+    line.fileId = 0;
+    line.level = LOG_LEVEL_INFO;
     consolePushLine(console, line);
 
     console.bytesRead += written;
     console.bottom = (console.bottom + written) % console.size;
+    logWrite(consoleEnd, written);
 }
 
 void log(const char* level, const char* fileName, int lineNumber, const char* fmt, ...) {
-    char* consoleEnd = (char*)console.data + console.bottom;
+    std::lock_guard<std::mutex> guard(consoleLock);
+    char* lineStart = (char*)console.data + console.bottom;
+    char* consoleEnd = lineStart;
 
     ConsoleLine line;
     line.start = console.bottom;
+    line.position = console.bytesRead;
+    line.fileId = consoleFileId(fileName);
+    line.level = logLevelFromName(level);
 
     const char* prefixFmt = "[%s] [%f] [%s:%d] ";
 
-    fprintf(logFile, prefixFmt, level, getElapsed(), fileName, lineNumber);
     int written = sprintf(consoleEnd, prefixFmt, level, getElapsed(), fileName, lineNumber);
     line.size = written;
     console.bytesRead += written;
@@ -159,7 +931,6 @@ void log(const char* level, const char* fileName, int lineNumber, const char* fm
 
     va_list args;
     va_start(args, fmt);
-    vfprintf(logFile, fmt, args);
     written = vsnprintf(consoleEnd, console.size, fmt, args);
     line.size += written;
     console.bytesRead += written;
@@ -167,30 +938,643 @@ void log(const char* level, const char* fileName, int lineNumber, const char* fm
     consoleEnd = (char*)console.data + console.bottom;
     va_end(args);
 
-    fprintf(logFile, "\n");
     written = sprintf(consoleEnd, "\n");
     line.size += written;
     console.bytesRead += written;
     console.bottom = (console.bottom + written) % console.size;
-    fflush(logFile);
 
     consolePushLine(console, line);
+    logWrite(lineStart, line.size);
+}
+
+// *****************
+// * Repeat stuff. *
+// *****************
+
+// NOTE(jan): Lines are rate limited with a token bucket per call site, or per
+// key for LOG_KEYED. Each may log burst lines at once and then
+// perSecond lines a second. Dropped lines are counted, and the count is
+// logged as "xN in last T ms" before the next line that gets through, or by
+// logRepeatsReport. Set this before other threads log.
+struct LogRateConfig {
+    // NOTE(jan): Call sites log below minLevel unlimited. Keyed lines are
+    // limited from the lowest level up.
+    u32 minLevel = LOG_LEVEL_WARN;
+    // NOTE(jan): Neither is limited above maxLevel, so errors are never
+    // dropped unless this is raised to LOG_LEVEL_ERR.
+    u32 maxLevel = LOG_LEVEL_WARN;
+    u32 burst = 8;
+    // NOTE(jan): 0 turns limiting off.
+    u32 perSecond = 4;
+};
+
+LogRateConfig logRate;
+
+struct LogRepeat {
+    // NOTE(jan): The bucket is kept as the time it will next be full, so
+    // taking a token is one compare and swap.
+    std::atomic<u64> allowAt;
+    std::atomic<u32> dropped;
+    // NOTE(jan): When the first of the dropped lines came in.
+    std::atomic<u64> since;
+    // NOTE(jan): Filled in before the first line is dropped, when this is
+    // linked into logRepeats.
+    std::atomic<bool> listed;
+    const char* name;
+    const char* fileName;
+    int lineNumber;
+    const char* what;
+    LogRepeat* next;
+};
+
+const u32 LOG_MESSAGE_SLOTS = 256;
+const u32 LOG_MESSAGE_PROBES = 8;
+
+// NOTE(jan): Keys are open addressed, so each keeps its own bucket. A key
+// that finds all of its probe slots taken by others takes over its home slot
+// but keeps the bucket and its count, so keys that keep evicting each other
+// are limited and reported together.
+struct LogMessageSlot {
+    u64 key;
+    LogRepeat repeat;
+    char text[128];
+};
+
+struct LogRepeats {
+    std::mutex lock;
+    LogRepeat* first;
+    LogMessageSlot messages[LOG_MESSAGE_SLOTS];
+};
+
+LogRepeats logRepeats;
+
+bool
+logRepeatTake(LogRepeat* repeat, u64 now) {
+    if (logRate.perSecond == 0) return true;
+    u64 interval = 1000000000ull / logRate.perSecond;
+    u64 tolerance = interval * (logRate.burst ? logRate.burst - 1 : 0);
+
+    u64 allowAt = repeat->allowAt.load(std::memory_order_relaxed);
+    u64 next;
+    do {
+        u64 start = allowAt > now ? allowAt : now;
+        if (start - now > tolerance) return false;
+        next = start + interval;
+    } while (!repeat->allowAt.compare_exchange_weak(allowAt, next, std::memory_order_relaxed));
+    return true;
+}
+
+// NOTE(jan): Caller holds logRepeats.lock.
+void
+logRepeatLink(LogRepeat* repeat) {
+    repeat->next = logRepeats.first;
+    logRepeats.first = repeat;
+    repeat->listed.store(true, std::memory_order_release);
+}
+
+// NOTE(jan): Takes logRepeats.lock.
+void
+logRepeatList(LogRepeat* repeat, const char* name, const char* fileName, int lineNumber, const char* what) {
+    std::lock_guard<std::mutex> guard(logRepeats.lock);
+    if (repeat->listed.load(std::memory_order_relaxed)) return;
+    repeat->name = name;
+    repeat->fileName = fileName;
+    repeat->lineNumber = lineNumber;
+    repeat->what = what;
+    logRepeatLink(repeat);
+}
+
+inline void
+logRepeatDrop(LogRepeat* repeat, u64 now) {
+    if (repeat->dropped.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        repeat->since.store(now, std::memory_order_relaxed);
+    }
+}
+
+// NOTE(jan): A copy of a repeat's count, so that it can be logged after
+// logRepeats.lock is let go, when a slot may already hold another key.
+struct LogRepeatSummary {
+    const char* name;
+    const char* fileName;
+    int lineNumber;
+    u32 dropped;
+    u64 milliseconds;
+    char what[128];
+};
+
+bool
+logRepeatCollect(LogRepeat* repeat, u64 now, LogRepeatSummary* summary) {
+    u32 dropped = repeat->dropped.exchange(0, std::memory_order_acq_rel);
+    if (!dropped) return false;
+    u64 since = repeat->since.load(std::memory_order_relaxed);
+    summary->name = repeat->name;
+    summary->fileName = repeat->fileName;
+    summary->lineNumber = repeat->lineNumber;
+    summary->dropped = dropped;
+    summary->milliseconds = now > since ? (now - since) / 1000000 : 0;
+    snprintf(summary->what, sizeof(summary->what), "%s", repeat->what ? repeat->what : "");
+    return true;
+}
+
+void
+logRepeatEmit(LogRepeatSummary* summary) {
+    log(summary->name, summary->fileName, summary->lineNumber, "x%u in last %llu ms: %s",
+        summary->dropped, (unsigned long long)summary->milliseconds, summary->what);
+}
+
+// NOTE(jan): Only for call site repeats, whose fields never change once
+// listed. Keyed repeats are collected under logRepeats.lock.
+void
+logRepeatSummary(LogRepeat* repeat, u64 now) {
+    LogRepeatSummary summary;
+    if (logRepeatCollect(repeat, now, &summary)) logRepeatEmit(&summary);
+}
+
+// NOTE(jan): Logs the counts of lines dropped since they were last reported.
+// Call it now and then, e.g. once a frame, so that the end of a storm is not
+// left unreported. Repeats are only ever pushed on the front of the list, so
+// it can be walked between taking the lock for each one.
+void
+logRepeatsReport() {
+    u64 now = clockNow();
+    LogRepeat* repeat;
+    {
+        std::lock_guard<std::mutex> guard(logRepeats.lock);
+        repeat = logRepeats.first;
+    }
+    for (; repeat; repeat = repeat->next) {
+        LogRepeatSummary summary;
+        bool pending;
+        {
+            std::lock_guard<std::mutex> guard(logRepeats.lock);
+            pending = logRepeatCollect(repeat, now, &summary);
+        }
+        if (pending) logRepeatEmit(&summary);
+    }
+}
+
+// NOTE(jan): FNV-1a.
+inline u64
+logHash(const char* s) {
+    u64 result = 0xcbf29ce484222325ull;
+    while (*s) {
+        result = (result ^ (u8)*s++) * 0x100000001b3ull;
+    }
+    return result;
+}
+
+// NOTE(jan): Caller holds logRepeats.lock.
+LogMessageSlot*
+logMessageSlot(u64 key) {
+    LogMessageSlot* home = &logRepeats.messages[key % LOG_MESSAGE_SLOTS];
+    for (u32 probe = 0; probe < LOG_MESSAGE_PROBES; probe++) {
+        LogMessageSlot* slot = &logRepeats.messages[(key + probe) % LOG_MESSAGE_SLOTS];
+        if (!slot->repeat.listed.load(std::memory_order_relaxed) || slot->key == key) return slot;
+    }
+    return home;
+}
+
+// NOTE(jan): The key should be stable for what is being limited, and what is
+// the text the dropped count is reported with.
+bool
+logMessageAllow(u32 level, const char* name, const char* fileName, int lineNumber, u64 key, const char* what) {
+    if (level > logRate.maxLevel) return true;
+    u64 now = clockNow();
+    LogRepeatSummary summary;
+    bool pending = false;
+    bool allowed;
+    {
+        std::lock_guard<std::mutex> guard(logRepeats.lock);
+        LogMessageSlot* slot = logMessageSlot(key);
+        LogRepeat* repeat = &slot->repeat;
+        if (!repeat->listed.load(std::memory_order_relaxed)) {
+            logRepeatLink(repeat);
+        }
+        // NOTE(jan): While a count is pending it keeps the text of the key
+        // that started it.
+        if (!repeat->what ||
+                (slot->key != key && !repeat->dropped.load(std::memory_order_relaxed))) {
+            snprintf(slot->text, sizeof(slot->text), "%s", what);
+            repeat->name = name;
+            repeat->fileName = fileName;
+            repeat->lineNumber = lineNumber;
+            repeat->what = slot->text;
+        }
+        slot->key = key;
+
+        allowed = logRepeatTake(repeat, now);
+        if (!allowed) {
+            logRepeatDrop(repeat, now);
+        } else {
+            pending = logRepeatCollect(repeat, now, &summary);
+        }
+    }
+    if (pending) logRepeatEmit(&summary);
+    return allowed;
+}
+
+// ****************
+// * Level stuff. *
+// ****************
+
+// NOTE(jan): Calls below this level are compiled out, arguments and all.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// NOTE(jan): Calls from files whose path contains category log at level and
+// up. Later rules win, and / and \ match each other.
+struct LogLevelRule {
+    char category[64];
+    u32 level;
+};
+
+const u32 LOG_MAX_LEVEL_RULES = 32;
+
+struct LogLevels {
+    std::mutex lock;
+    LogLevelRule rules[LOG_MAX_LEVEL_RULES];
+    u32 ruleCount;
+    u32 defaultLevel = LOG_LEVEL_INFO;
+    // NOTE(jan): Bumped whenever the rules change, so call sites know to look
+    // their level up again.
+    std::atomic<u32> generation{1};
+};
+
+LogLevels logLevels;
+
+// NOTE(jan): One per call site, caching the level that applies to its file.
+// NOTE(jan): Defaulted members, so that LOG_AT can initialise it with just
+// the file name.
+struct LogSite {
+    const char* fileName = nullptr;
+    std::atomic<u32> generation{0};
+    std::atomic<u32> level{0};
+    LogRepeat repeat{};
+};
+
+bool
+logCategoryMatches(const char* fileName, const char* category) {
+    for (const char* start = fileName; *start; start++) {
+        const char* f = start;
+        const char* c = category;
+        while (*f && *c) {
+            bool separators = (*f == '/' || *f == '\\') && (*c == '/' || *c == '\\');
+            if (*f != *c && !separators) break;
+            f++;
+            c++;
+        }
+        if (!*c) return true;
+    }
+    return false;
+}
+
+u32
+logLevelFor(const char* fileName) {
+    std::lock_guard<std::mutex> guard(logLevels.lock);
+    u32 result = logLevels.defaultLevel;
+    for (u32 i = 0; i < logLevels.ruleCount; i++) {
+        LogLevelRule& rule = logLevels.rules[i];
+        if (logCategoryMatches(fileName, rule.category)) result = rule.level;
+    }
+    return result;
+}
+
+void
+logSetLevel(u32 level) {
+    std::lock_guard<std::mutex> guard(logLevels.lock);
+    logLevels.defaultLevel = level;
+    logLevels.generation.fetch_add(1, std::memory_order_release);
+}
+
+void
+logSetLevel(const char* category, u32 level) {
+    std::lock_guard<std::mutex> guard(logLevels.lock);
+    LogLevelRule* rule = nullptr;
+    for (u32 i = 0; i < logLevels.ruleCount; i++) {
+        if (strcmp(logLevels.rules[i].category, category) == 0) {
+            rule = &logLevels.rules[i];
+        }
+    }
+    if (!rule) {
+        if (logLevels.ruleCount == LOG_MAX_LEVEL_RULES) return;
+        rule = &logLevels.rules[logLevels.ruleCount++];
+        snprintf(rule->category, sizeof(rule->category), "%s", category);
+    }
+    rule->level = level;
+    logLevels.generation.fetch_add(1, std::memory_order_release);
+}
+
+inline bool
+logSiteEnabled(LogSite* site, u32 level) {
+    u32 generation = logLevels.generation.load(std::memory_order_acquire);
+    if (site->generation.load(std::memory_order_acquire) != generation) {
+        site->level.store(logLevelFor(site->fileName), std::memory_order_relaxed);
+        site->generation.store(generation, std::memory_order_release);
+    }
+    return level >= site->level.load(std::memory_order_relaxed);
+}
+
+inline bool
+logSiteAllow(LogSite* site, u32 level, const char* name, int lineNumber, const char* fmt) {
+    if (level < logRate.minLevel || level > logRate.maxLevel) return true;
+    u64 now = clockNow();
+    LogRepeat* repeat = &site->repeat;
+    if (!logRepeatTake(repeat, now)) {
+        if (!repeat->listed.load(std::memory_order_acquire)) {
+            logRepeatList(repeat, name, site->fileName, lineNumber, fmt);
+        }
+        logRepeatDrop(repeat, now);
+        return false;
+    }
+    if (repeat->dropped.load(std::memory_order_relaxed)) logRepeatSummary(repeat, now);
+    return true;
+}
+
+// *****************
+// * Search stuff. *
+// *****************
+
+struct ConsoleFilter {
+    // NOTE(jan): Bits 1 << LOG_LEVEL_* to match, or 0 for every level.
+    u32 levels;
+    // NOTE(jan): If set, only lines logged from files whose path contains
+    // this, matched like a level rule category.
+    const char* file;
+    // NOTE(jan): If set, only lines whose text contains this, ignoring ASCII
+    // case.
+    const char* text;
+};
+
+bool
+consoleContains(const char* text, umm length, const char* needle, umm needleLength) {
+    if (needleLength > length) return false;
+    for (umm i = 0; i + needleLength <= length; i++) {
+        umm j = 0;
+        while (j < needleLength && consoleFold(text[i + j]) == consoleFold(needle[j])) j++;
+        if (j == needleLength) return true;
+    }
+    return false;
+}
+
+template<typename Summary>
+inline bool
+consoleSummaryMatches(Summary& summary, u32 levelMask, u64 fileMask, u64* query) {
+    if (!(summary.levels & levelMask) || !(summary.files & fileMask)) return false;
+    if (!query) return true;
+    const umm words = sizeof(summary.trigrams) / sizeof(u64);
+    for (umm i = 0; i < words; i++) {
+        if ((summary.trigrams[i] & query[i]) != query[i]) return false;
+    }
+    return true;
+}
+
+// NOTE(jan): Writes the LineBuffer::data slots of up to maxResults matching
+// lines to results, newest first, and returns how many it wrote. Blocks are
+// skipped on their level and file summaries, and lines on their trigrams,
+// before any text is compared. Lines whose text has been overwritten in the
+// ring are not searched. Takes consoleLock while it searches; take it again
+// to read the lines it found, since loggers may overwrite them in between.
+umm
+consoleSearch(Console& console, ConsoleFilter& filter, umm* results, umm maxResults) {
+    std::lock_guard<std::mutex> guard(consoleLock);
+    LineBuffer& lines = console.lines;
+    u32 levelMask = filter.levels ? filter.levels : 0xffffffff;
+
+    bool fileWanted[CONSOLE_MAX_FILES];
+    u64 fileMask = 0xffffffffffffffffull;
+    if (filter.file) {
+        fileMask = 0;
+        fileWanted[0] = false;
+        for (u32 i = 1; i < consoleFiles.count; i++) {
+            fileWanted[i] = logCategoryMatches(consoleFiles.names[i], filter.file);
+            if (fileWanted[i]) fileMask |= 1ull << (i % 64);
+        }
+        if (!fileMask) return 0;
+    }
+
+    u64 lineQuery[2] = {};
+    u64 blockQuery[16] = {};
+    u64 groupQuery[128] = {};
+    umm textLength = 0;
+    if (filter.text) {
+        textLength = strlen(filter.text);
+        consoleTrigrams(filter.text, textLength, lineQuery, blockQuery, groupQuery);
+    }
+    // NOTE(jan): Without text the summaries' trigrams are not read at all.
+    u64* blockTrigrams = filter.text ? blockQuery : nullptr;
+    u64* groupTrigrams = filter.text ? groupQuery : nullptr;
+
+    umm newest = (lines.next + lines.max - 1) % lines.max;
+    umm newestBlock = newest / CONSOLE_LINE_BLOCK_SIZE;
+    umm newestGroup = newest / CONSOLE_LINE_GROUP_SIZE;
+
+    umm found = 0;
+    umm i = 0;
+    while (i < lines.count && found < maxResults) {
+        // NOTE(jan): Going backwards, the rest of a block or group is the
+        // slots down to its first, so skipping one moves i that far.
+        umm slot = (newest + lines.max - i) % lines.max;
+
+        ConsoleLineGroup& group = lines.groups[slot / CONSOLE_LINE_GROUP_SIZE];
+        if (slot / CONSOLE_LINE_GROUP_SIZE != newestGroup &&
+                !consoleSummaryMatches(group, levelMask, fileMask, groupTrigrams)) {
+            i += slot % CONSOLE_LINE_GROUP_SIZE + 1;
+            continue;
+        }
+
+        ConsoleLineBlock& block = lines.blocks[slot / CONSOLE_LINE_BLOCK_SIZE];
+        if (slot / CONSOLE_LINE_BLOCK_SIZE != newestBlock &&
+                !consoleSummaryMatches(block, levelMask, fileMask, blockTrigrams)) {
+            i += slot % CONSOLE_LINE_BLOCK_SIZE + 1;
+            continue;
+        }
+        i++;
+
+        ConsoleLine& line = lines.data[slot];
+        if (console.bytesRead - line.position > console.size) break;
+        if (!((1u << line.level) & levelMask)) continue;
+        if (filter.file && !fileWanted[line.fileId]) continue;
+        if (filter.text) {
+            if ((line.trigrams[0] & lineQuery[0]) != lineQuery[0]) continue;
+            if ((line.trigrams[1] & lineQuery[1]) != lineQuery[1]) continue;
+            const char* text = (const char*)console.data + line.start;
+            if (!consoleContains(text, line.size, filter.text, textLength)) continue;
+        }
+        results[found++] = slot;
+    }
+    return found;
+}
+
+// *************************
+// * Binary logging stuff. *
+// *************************
+
+// NOTE(jan): With LOG_BINARY defined, LOG only copies its arguments into the
+// writer's ring and the writer thread formats them. fmt, the level and the
+// file name are kept as pointers, so they must be literals; strings passed as
+// arguments are copied. Binary lines go to the log file but not the console.
+// Until the writer is started, LOG formats on the calling thread as usual.
+
+// NOTE(jan): Arguments are stored as the type printf would read them as.
+template<typename T>
+using LogStored = typename std::conditional<
+    std::is_same<T, float>::value, double,
+    typename std::conditional<std::is_same<T, char*>::value, const char*, T>::type
+>::type;
+
+template<typename T>
+inline umm
+logArgSize(T) {
+    static_assert(std::is_trivially_copyable<T>::value, "log arguments must be trivially copyable");
+    return sizeof(T);
+}
+
+inline umm
+logArgSize(const char* s) {
+    return sizeof(u32) + strlen(s ? s : "(null)") + 1;
 }
 
-#define LOG(level, fmt, ...) log(level, __FILE__, __LINE__, fmt, __VA_ARGS__)
+template<typename T>
+inline void
+logArgWrite(u8*& at, T value) {
+    memcpy(at, &value, sizeof(T));
+    at += sizeof(T);
+}
+
+inline void
+logArgWrite(u8*& at, const char* s) {
+    if (!s) s = "(null)";
+    u32 length = (u32)strlen(s);
+    memcpy(at, &length, sizeof(u32));
+    memcpy(at + sizeof(u32), s, length + 1);
+    at += sizeof(u32) + length + 1;
+}
+
+template<typename T>
+inline T
+logArgRead(const u8*& at) {
+    T result;
+    memcpy(&result, at, sizeof(T));
+    at += sizeof(T);
+    return result;
+}
+
+template<>
+inline const char*
+logArgRead<const char*>(const u8*& at) {
+    u32 length;
+    memcpy(&length, at, sizeof(u32));
+    const char* result = (const char*)(at + sizeof(u32));
+    at += sizeof(u32) + length + 1;
+    return result;
+}
+
+template<typename... Args>
+umm
+logRenderArgs(const LogBinaryRecord* record, char* out, umm size) {
+    [[maybe_unused]] const u8* at = (const u8*)(record + 1);
+    // NOTE(jan): Braced initializers are evaluated left to right.
+    std::tuple<Args...> values{logArgRead<Args>(at)...};
+    int written = std::apply([&](Args... args) {
+        return snprintf(out, size, record->fmt, args...);
+    }, values);
+    if (written < 0) return 0;
+    return (umm)written < size ? written : size - 1;
+}
+
+template<typename... Args>
+void
+logBinary(const char* level, const char* fileName, int lineNumber, const char* fmt, Args... args) {
+    umm length = sizeof(LogBinaryRecord);
+    ((length += logArgSize((LogStored<Args>)args)), ...);
+
+    if (!logWriter.running.load(std::memory_order_acquire) || length > logWriterMaxLength()) {
+        log(level, fileName, lineNumber, fmt, args...);
+        return;
+    }
+
+    LogRecordHeader* header = logWriterReserve(length);
+    if (!header) return;
+
+    LogBinaryRecord* record = (LogBinaryRecord*)(header + 1);
+    record->level = level;
+    record->fileName = fileName;
+    record->fmt = fmt;
+    record->render = logRenderArgs<LogStored<Args>...>;
+    record->nanoseconds = clockNow();
+    record->lineNumber = lineNumber;
+
+    [[maybe_unused]] u8* at = (u8*)(record + 1);
+    (logArgWrite(at, (LogStored<Args>)args), ...);
+    logWriterCommit(header, (u32)length | LOG_RECORD_BINARY);
+}
+
+#ifdef LOG_BINARY
+#define LOG(level, fmt, ...) logBinary(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#else
+#define LOG(level, fmt, ...) log(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+#endif
 #define FATAL(fmt, ...) {\
-    LOG("FATAL", fmt, __VA_ARGS__);\
-    fclose(logFile);\
+    LOG("FATAL", fmt, ##__VA_ARGS__);\
+    logRepeatsReport();\
+    logClose();\
     exit(4);\
 }
-#define INFO(fmt, ...) LOG("INFO", fmt, __VA_ARGS__)
-#define WARN(fmt, ...) LOG("WARN", fmt, __VA_ARGS__)
-#define ERR(fmt, ...) LOG("ERR", fmt, __VA_ARGS__)
 
-#define CHECK(x, fmt, ...) if (!x) { FATAL(fmt, __VA_ARGS__) }
+// NOTE(jan): The level and rate checks come before the arguments are
+// evaluated.
+#define LOG_AT(level, name, fmt, ...) do {\
+    static LogSite logSite = {__FILE__};\
+    if (logSiteEnabled(&logSite, level) &&\
+            logSiteAllow(&logSite, level, name, __LINE__, fmt)) {\
+        LOG(name, fmt, ##__VA_ARGS__);\
+    }\
+} while (0)
+
+// NOTE(jan): Like LOG_AT, but rate limited per u64 key instead of per call
+// site, for call sites that pass many different messages through. Dropped
+// lines are reported with what.
+#define LOG_KEYED(level, name, key, what, fmt, ...) do {\
+    static LogSite logSite = {__FILE__};\
+    if (logSiteEnabled(&logSite, level) &&\
+            logMessageAllow(level, name, __FILE__, __LINE__, key, what)) {\
+        LOG(name, fmt, ##__VA_ARGS__);\
+    }\
+} while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define DBG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, "DEBUG", fmt, ##__VA_ARGS__)
+#else
+#define DBG(fmt, ...) do {} while (0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, "INFO", fmt, ##__VA_ARGS__)
+#else
+#define INFO(fmt, ...) do {} while (0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, "WARN", fmt, ##__VA_ARGS__)
+#else
+#define WARN(fmt, ...) do {} while (0)
+#endif
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERR
+#define ERR(fmt, ...) LOG_AT(LOG_LEVEL_ERR, "ERR", fmt, ##__VA_ARGS__)
+#else
+#define ERR(fmt, ...) do {} while (0)
+#endif
+
+#define CHECK(x, fmt, ...) if (!x) { FATAL(fmt, ##__VA_ARGS__) }
+#ifdef WIN32
 #define LERROR(x) \
     if (x) {      \
         char buffer[1024]; \
         strerror_s(buffer, x); \
         FATAL("%s", buffer); \
     }
+#else
+#define LERROR(x) \
+    if (x) {      \
+        FATAL("%s", strerror(x)); \
+    }
+#endif
@@ -281,7 +281,7 @@ static inline float quaternionMagnitude(Quaternion& q) {
 }
 
 static inline void quaternionLog(Quaternion& q) {
-    INFO("%f %f %f %f %f", quaternionMagnitude(q), q.w, q.x, q.y, q.z);
+    DBG("%f %f %f %f %f", quaternionMagnitude(q), q.w, q.x, q.y, q.z);
 }
 
 static inline void quaternionNormalize(Quaternion& q) {
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <mutex>
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 #include "Logging.cpp"
 #include "Types.h"
@@ -10,29 +18,261 @@
 #endif
 
 #define byteOffset(ptr, count) ((void*)(((u8*)ptr) + count))
+#define alignUp(x, alignment) (((x) + ((alignment) - 1)) & ~((umm)(alignment) - 1))
 
 const umm MEMORY_ALIGNMENT = 4;
 const umm MIN_BLOCK_SIZE = 1024 * 1024;
 
+// NOTE(jan): The block was mapped directly from the OS rather than taken from
+// the C heap.
+const u32 MEMORY_BLOCK_MAPPED = 1 << 0;
+
 struct MemoryBlock {
     MemoryBlock* next;
     void* head;
     umm size;
     umm free;
+    u32 flags;
+    // NOTE(jan): Links into the arena's index of blocks with reusable tails.
+    s32 bucket;
+    MemoryBlock* prevTail;
+    MemoryBlock* nextTail;
 };
 
 const umm MemoryBlockDataOffset = sizeof(MemoryBlock);
 
+// NOTE(jan): Blocks of pooled arenas go back to the block pool on clear
+// instead of being freed, and new blocks are taken from it first.
+const u32 MEMORY_ARENA_POOLED = 1 << 0;
+// NOTE(jan): Virtual arenas reserve one contiguous range of address space up
+// front and commit it as the head advances. They consist of a single block
+// whose header lives at the start of the range, and never grow a new one.
+const u32 MEMORY_ARENA_VIRTUAL = 1 << 1;
+// NOTE(jan): Back blocks with 2 MiB pages where the OS allows it, to cut TLB
+// misses when walking large arrays. Falls back to normal pages silently.
+const u32 MEMORY_ARENA_HUGE_PAGES = 1 << 2;
+
+const umm VIRTUAL_COMMIT_SIZE = 64 * 1024;
+const umm HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// NOTE(jan): Tails of blocks that allocation has moved past are indexed by
+// size, bucket i holding tails of [2^(i + MIN_TAIL_SHIFT), 2^(i + MIN_TAIL_SHIFT + 1))
+// bytes. Smaller tails are not worth tracking.
+const umm MIN_TAIL_SHIFT = 6;
+const s32 TAIL_BUCKET_COUNT = 32;
+
+struct SharedMemoryArena;
+
+// NOTE(jan): Kept up to date on every allocation, so that none of these need
+// a walk over the blocks.
+struct MemoryArenaStats {
+    // NOTE(jan): Everything taken out of blocks, including block headers and
+    // alignment padding.
+    umm used;
+    umm padding;
+    // NOTE(jan): Free space left behind in blocks that allocation has moved
+    // past. Included in getMemoryArenaFree; only tails in the index will be
+    // handed out again.
+    umm tailWaste;
+    // NOTE(jan): Total bytes that have been allocated out of such tails.
+    umm recovered;
+    umm blockCount;
+    umm peak;
+};
+
 struct MemoryArena {
     MemoryBlock* first;
     MemoryBlock* last;
     umm size;
+    MemoryArenaStats stats;
+    u32 tempCount;
+    u32 flags;
+    // NOTE(jan): Head of the last block when the innermost temp was begun.
+    // Allocations below it must not be resized in place, because ending the
+    // temp rewinds the block to this point.
+    void* tempMark;
+    umm reserve;
+    umm committed;
+    // NOTE(jan): Where a virtual arena asked to be reserved, or nullptr to let
+    // the OS pick.
+    void* base;
+    // NOTE(jan): Child arenas take their blocks from a shared parent arena.
+    SharedMemoryArena* parent;
+    MemoryBlock* tails[TAIL_BUCKET_COUNT];
 };
 
+// NOTE(jan): Counts calls into the C heap, so that steady state can be
+// verified to not allocate.
+struct MemoryHeapCounters {
+    std::atomic<u64> mallocs;
+    std::atomic<u64> frees;
+    std::atomic<u64> poolReuses;
+    std::atomic<u64> commits;
+    std::atomic<u64> hugePageBlocks;
+    std::atomic<u64> hugePageFallbacks;
+};
+
+MemoryHeapCounters memoryHeapCounters;
+
+struct MemoryBlockPool {
+    MemoryBlock* first;
+    umm count;
+    umm size;
+    std::mutex lock;
+};
+
+MemoryBlockPool memoryBlockPool;
+
+// NOTE(jan): An arena that can be allocated from by many threads at once.
+// The fast path bumps the current block's offset with an atomic add; only
+// replacing a full block takes the lock.
+struct SharedMemoryBlock {
+    SharedMemoryBlock* next;
+    umm size;
+    std::atomic<umm> used;
+};
+
+const umm SharedMemoryBlockDataOffset = alignUp(sizeof(SharedMemoryBlock), 64);
+const umm SHARED_MIN_BLOCK_SIZE = 16 * MIN_BLOCK_SIZE;
+
+struct SharedMemoryArena {
+    std::atomic<SharedMemoryBlock*> current;
+    SharedMemoryBlock* first;
+    std::atomic<umm> size;
+    std::mutex lock;
+};
+
+// NOTE(jan): If base is given the range is reserved exactly there, or not at
+// all.
+void*
+memoryReserve(umm size, void* base = nullptr) {
+#ifdef WIN32
+    return VirtualAlloc(base, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_FIXED_NOREPLACE
+    if (base) flags |= MAP_FIXED_NOREPLACE;
+#endif
+    void* result = mmap(base, size, PROT_NONE, flags, -1, 0);
+    if (result == MAP_FAILED) return nullptr;
+    if (base && result != base) {
+        munmap(result, size);
+        return nullptr;
+    }
+    return result;
+#endif
+}
+
+bool
+memoryCommit(void* data, umm size) {
+    memoryHeapCounters.commits++;
+#ifdef WIN32
+    return VirtualAlloc(data, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(data, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void
+memoryRelease(void* data, umm size) {
+#ifdef WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, size);
+#endif
+}
+
+#ifdef WIN32
+bool
+memoryEnableLargePages() {
+    static int enabled = -1;
+    if (enabled >= 0) return enabled;
+
+    // NOTE(jan): Large pages need SeLockMemoryPrivilege, which has to be
+    // granted to the user and then enabled on the process token.
+    enabled = 0;
+    HANDLE token;
+    if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        TOKEN_PRIVILEGES privileges = {};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+            AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+            enabled = GetLastError() == ERROR_SUCCESS;
+        }
+        CloseHandle(token);
+    }
+    return enabled;
+}
+#endif
+
+// NOTE(jan): Maps size bytes, which must be a multiple of HUGE_PAGE_SIZE, and
+// tries to have them backed by huge pages. Returns nullptr if the mapping
+// itself fails.
+void*
+memoryMapHugePages(umm size) {
+#ifdef WIN32
+    umm largePageSize = GetLargePageMinimum();
+    if (largePageSize && (size % largePageSize == 0) && memoryEnableLargePages()) {
+        void* result = VirtualAlloc(
+            NULL,
+            size,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+            PAGE_READWRITE
+        );
+        if (result) {
+            memoryHeapCounters.hugePageBlocks++;
+            return result;
+        }
+    }
+    memoryHeapCounters.hugePageFallbacks++;
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+    void* result = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (result != MAP_FAILED) {
+        memoryHeapCounters.hugePageBlocks++;
+        return result;
+    }
+#endif
+
+    // NOTE(jan): No explicit huge pages configured, so ask for transparent
+    // ones. Those need a 2 MiB aligned range, so over-map and trim.
+    umm mappedSize = size + HUGE_PAGE_SIZE;
+    void* mapped = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mapped == MAP_FAILED) return nullptr;
+
+    u8* start = (u8*)alignUp((umm)mapped, HUGE_PAGE_SIZE);
+    umm head = start - (u8*)mapped;
+    if (head > 0) munmap(mapped, head);
+    munmap(start + size, mappedSize - head - size);
+
+#ifdef MADV_HUGEPAGE
+    if (madvise(start, size, MADV_HUGEPAGE) == 0) {
+        memoryHeapCounters.hugePageBlocks++;
+        return start;
+    }
+#endif
+    memoryHeapCounters.hugePageFallbacks++;
+    return start;
+#endif
+}
+
 MemoryBlock*
-memoryArenaAllocateBlock(umm size) {
+memoryArenaAllocateBlock(umm size, u32 arenaFlags = 0) {
     size = max(MIN_BLOCK_SIZE, size);
-    void* data = malloc(size);
+
+    void* data = nullptr;
+    u32 blockFlags = 0;
+    if (arenaFlags & MEMORY_ARENA_HUGE_PAGES) {
+        size = alignUp(size, HUGE_PAGE_SIZE);
+        data = memoryMapHugePages(size);
+        blockFlags = MEMORY_BLOCK_MAPPED;
+    } else {
+        data = malloc(size);
+        memoryHeapCounters.mallocs++;
+    }
 
     if (!data) {
         FATAL("Could not allocate block of size %llu", size);
@@ -43,38 +283,295 @@ memoryArenaAllocateBlock(umm size) {
     block->head = byteOffset(data, MemoryBlockDataOffset);
     block->size = size;
     block->free = size - MemoryBlockDataOffset;
+    block->flags = blockFlags;
+    block->bucket = -1;
 
     return block;
 }
 
+void
+memoryBlockReset(MemoryBlock* block) {
+    block->head = byteOffset(block, MemoryBlockDataOffset);
+    block->free = block->size - MemoryBlockDataOffset;
+}
+
+void
+memoryArenaFreeBlock(MemoryBlock* block) {
+    if (block->flags & MEMORY_BLOCK_MAPPED) {
+        memoryRelease(block, block->size);
+    } else {
+        free(block);
+        memoryHeapCounters.frees++;
+    }
+}
+
+void* sharedMemoryArenaAllocate(SharedMemoryArena* arena, umm size, umm alignment);
+
+MemoryBlock*
+memoryArenaAcquireBlock(MemoryArena* arena, umm size) {
+    if (arena->parent != nullptr) {
+        size = max(MIN_BLOCK_SIZE, size);
+        void* data = sharedMemoryArenaAllocate(arena->parent, size, 64);
+        auto* block = (MemoryBlock*)data;
+        block->next = nullptr;
+        block->size = size;
+        block->flags = 0;
+        block->bucket = -1;
+        memoryBlockReset(block);
+        return block;
+    }
+
+    if (arena->flags & MEMORY_ARENA_POOLED) {
+        std::lock_guard<std::mutex> guard(memoryBlockPool.lock);
+        MemoryBlock** link = &memoryBlockPool.first;
+        while (*link != nullptr) {
+            MemoryBlock* block = *link;
+            if (block->size >= size) {
+                *link = block->next;
+                memoryBlockPool.count--;
+                memoryBlockPool.size -= block->size;
+                memoryHeapCounters.poolReuses++;
+
+                block->next = nullptr;
+                block->bucket = -1;
+                memoryBlockReset(block);
+                return block;
+            }
+            link = &block->next;
+        }
+    }
+    return memoryArenaAllocateBlock(size, arena->flags);
+}
+
+void
+memoryArenaReleaseBlock(MemoryArena* arena, MemoryBlock* block) {
+    if (arena->parent != nullptr) {
+        // NOTE(jan): Owned by the parent, and released when it is cleared.
+    } else if (arena->flags & MEMORY_ARENA_POOLED) {
+        std::lock_guard<std::mutex> guard(memoryBlockPool.lock);
+        block->next = memoryBlockPool.first;
+        memoryBlockPool.first = block;
+        memoryBlockPool.count++;
+        memoryBlockPool.size += block->size;
+    } else {
+        memoryArenaFreeBlock(block);
+    }
+}
+
+// NOTE(jan): Returns every pooled block to the C heap.
+void
+memoryBlockPoolTrim() {
+    std::lock_guard<std::mutex> guard(memoryBlockPool.lock);
+    MemoryBlock* block = memoryBlockPool.first;
+    while (block != nullptr) {
+        MemoryBlock* next = block->next;
+        memoryArenaFreeBlock(block);
+        block = next;
+    }
+    memoryBlockPool.first = nullptr;
+    memoryBlockPool.count = 0;
+    memoryBlockPool.size = 0;
+}
+
+// NOTE(jan): Arenas reserved at a fixed base can be saved with
+// memoryArenaSave and mapped back at the same address, pointers and all.
+void
+memoryArenaInitVirtual(MemoryArena* arena, umm reserve, u32 flags = 0, void* base = nullptr) {
+    *arena = {};
+    arena->flags = MEMORY_ARENA_VIRTUAL | flags;
+    arena->reserve = alignUp(reserve, VIRTUAL_COMMIT_SIZE);
+    arena->base = base;
+}
+
+MemoryBlock*
+memoryArenaReserveBlock(MemoryArena* arena) {
+    void* data = memoryReserve(arena->reserve, arena->base);
+    if (!data) {
+        FATAL("could not reserve %llu bytes at %p", (u64)arena->reserve, arena->base);
+    }
+    if (!memoryCommit(data, VIRTUAL_COMMIT_SIZE)) {
+        FATAL("could not commit %llu bytes", (u64)VIRTUAL_COMMIT_SIZE);
+    }
+    arena->committed = VIRTUAL_COMMIT_SIZE;
+
+#if !defined(WIN32) && defined(MADV_HUGEPAGE)
+    // NOTE(jan): Windows large pages cannot be committed piecemeal, so only
+    // transparent huge pages apply here.
+    if (arena->flags & MEMORY_ARENA_HUGE_PAGES) {
+        madvise(data, arena->reserve, MADV_HUGEPAGE);
+    }
+#endif
+
+    auto* block = (MemoryBlock*)data;
+    block->next = nullptr;
+    block->size = arena->reserve;
+    block->flags = MEMORY_BLOCK_MAPPED;
+    block->bucket = -1;
+    memoryBlockReset(block);
+
+    return block;
+}
+
+void
+memoryArenaCommit(MemoryArena* arena, void* end) {
+    umm used = (umm)end - (umm)arena->first;
+    if (used <= arena->committed) return;
+
+    umm committed = alignUp(used, VIRTUAL_COMMIT_SIZE);
+    if (!memoryCommit(byteOffset(arena->first, arena->committed), committed - arena->committed)) {
+        FATAL("could not commit %llu bytes", (u64)(committed - arena->committed));
+    }
+    arena->committed = committed;
+}
+
+s32
+memoryArenaTailBucket(umm free) {
+    s32 result = -(s32)MIN_TAIL_SHIFT;
+    while (free > 1) {
+        free >>= 1;
+        result++;
+    }
+    return result < TAIL_BUCKET_COUNT ? result : TAIL_BUCKET_COUNT - 1;
+}
+
+void
+memoryArenaIndexTail(MemoryArena* arena, MemoryBlock* block) {
+    s32 bucket = memoryArenaTailBucket(block->free);
+    if (bucket < 0) return;
+
+    block->bucket = bucket;
+    block->prevTail = nullptr;
+    block->nextTail = arena->tails[bucket];
+    if (block->nextTail) block->nextTail->prevTail = block;
+    arena->tails[bucket] = block;
+}
+
+void
+memoryArenaUnindexTail(MemoryArena* arena, MemoryBlock* block) {
+    if (block->bucket < 0) return;
+
+    if (block->prevTail) {
+        block->prevTail->nextTail = block->nextTail;
+    } else {
+        arena->tails[block->bucket] = block->nextTail;
+    }
+    if (block->nextTail) block->nextTail->prevTail = block->prevTail;
+    block->bucket = -1;
+}
+
+void
+memoryArenaUse(MemoryArena* arena, umm size) {
+    arena->stats.used += size;
+    if (arena->stats.used > arena->stats.peak) {
+        arena->stats.peak = arena->stats.used;
+    }
+}
+
+void
+memoryArenaAddBlock(MemoryArena* arena, MemoryBlock* block) {
+    arena->size += block->size;
+    arena->stats.blockCount++;
+    memoryArenaUse(arena, MemoryBlockDataOffset);
+}
+
+// NOTE(jan): Padding needed to align the block's head is taken out of
+// MemoryBlock::free along with the request itself.
 bool
-memoryArenaTryAllocateFromBlock(MemoryBlock* block, umm size, void** data) {
-    if (size % MEMORY_ALIGNMENT != 0) size = ((size / MEMORY_ALIGNMENT) + 1) * MEMORY_ALIGNMENT;
-    if (block->free < size) return false;
+memoryArenaTryAllocateFromBlock(
+    MemoryArena* arena,
+    MemoryBlock* block,
+    umm size,
+    umm alignment,
+    void** data
+) {
+    size = alignUp(size, MEMORY_ALIGNMENT);
+    umm head = (umm)block->head;
+    umm padding = alignUp(head, alignment) - head;
+    if (block->free < size + padding) return false;
 
-    *data = block->head;
-    block->head = byteOffset(block->head, size);
-    block->free -= size;
+    *data = byteOffset(block->head, padding);
+    block->head = byteOffset(block->head, padding + size);
+    block->free -= padding + size;
+
+    arena->stats.padding += padding;
+    memoryArenaUse(arena, padding + size);
 
     return true;
 }
 
 void*
-memoryArenaAllocate(MemoryArena* arena, umm size) {
+memoryArenaAllocateAligned(MemoryArena* arena, umm size, umm alignment) {
+    if (alignment < MEMORY_ALIGNMENT) alignment = MEMORY_ALIGNMENT;
+    if (!isPowerOfTwo(alignment)) {
+        FATAL("alignment %llu is not a power of two", (u64)alignment);
+    }
+
+    // NOTE(jan): Worst case padding, so that a fresh block is always big enough.
+    umm blockSize = MemoryBlockDataOffset + size + alignment - 1;
+
     if (arena->first == nullptr) {
-        arena->first = memoryArenaAllocateBlock(size);
+        if (arena->flags & MEMORY_ARENA_VIRTUAL) {
+            arena->first = memoryArenaReserveBlock(arena);
+        } else {
+            arena->first = memoryArenaAcquireBlock(arena, blockSize);
+        }
         arena->last = arena->first;
-        arena->size = arena->first->size;
+        arena->size = 0;
+        memoryArenaAddBlock(arena, arena->first);
     }
 
     void* data = nullptr;
 
-    if (!memoryArenaTryAllocateFromBlock(arena->last, size, &data)) {
-        MemoryBlock* newBlock = memoryArenaAllocateBlock(size);
+    if (arena->flags & MEMORY_ARENA_VIRTUAL) {
+        if (!memoryArenaTryAllocateFromBlock(arena, arena->first, size, alignment, &data)) {
+            FATAL("virtual arena of %llu bytes is exhausted", (u64)arena->reserve);
+        }
+        memoryArenaCommit(arena, arena->first->head);
+        return data;
+    }
+
+    if (!memoryArenaTryAllocateFromBlock(arena, arena->last, size, alignment, &data)) {
+        // NOTE(jan): A rewind cannot give back memory allocated out of an
+        // older block's tail, so tails are only reused outside temp scopes.
+        if (arena->tempCount == 0) {
+            umm worstCase = alignUp(size, MEMORY_ALIGNMENT) + alignment - MEMORY_ALIGNMENT;
+            s32 bucket = memoryArenaTailBucket(worstCase);
+            if ((umm)1 << (bucket + MIN_TAIL_SHIFT) < worstCase) bucket++;
+            if (bucket < 0) bucket = 0;
+
+            for (; bucket < TAIL_BUCKET_COUNT; bucket++) {
+                MemoryBlock* tail = arena->tails[bucket];
+                if (tail == nullptr) continue;
+
+                umm free = tail->free;
+                if (!memoryArenaTryAllocateFromBlock(arena, tail, size, alignment, &data)) {
+                    continue;
+                }
+                arena->stats.tailWaste -= free - tail->free;
+                arena->stats.recovered += free - tail->free;
+                memoryArenaUnindexTail(arena, tail);
+                memoryArenaIndexTail(arena, tail);
+                return data;
+            }
+        }
+
+        arena->stats.tailWaste += arena->last->free;
+        memoryArenaIndexTail(arena, arena->last);
+
+        // NOTE(jan): Blocks past the last one are left over from a rewind and
+        // are empty, so reuse the next one if it is big enough.
+        MemoryBlock* next = arena->last->next;
+        if (next && memoryArenaTryAllocateFromBlock(arena, next, size, alignment, &data)) {
+            arena->last = next;
+            return data;
+        }
+
+        MemoryBlock* newBlock = memoryArenaAcquireBlock(arena, blockSize);
+        newBlock->next = next;
         arena->last->next = newBlock;
         arena->last = newBlock;
-        arena->size += newBlock->size;
-        if (!memoryArenaTryAllocateFromBlock(arena->last, size, &data)) {
+        memoryArenaAddBlock(arena, newBlock);
+        if (!memoryArenaTryAllocateFromBlock(arena, arena->last, size, alignment, &data)) {
             FATAL("could not allocate");
         }
     }
@@ -82,7 +579,75 @@ memoryArenaAllocate(MemoryArena* arena, umm size) {
     return data;
 }
 
-#define memoryArenaAllocateStruct(arena, type) (type*)memoryArenaAllocate(arena, sizeof(type))
+void*
+memoryArenaAllocate(MemoryArena* arena, umm size) {
+    return memoryArenaAllocateAligned(arena, size, MEMORY_ALIGNMENT);
+}
+
+// NOTE(jan): Grows or shrinks an allocation of oldSize bytes. If it is the
+// most recent allocation in the arena it is resized in place, otherwise it is
+// copied to a new allocation and the old one is left behind. Passing nullptr
+// for data is the same as allocating.
+void*
+memoryArenaResize(
+    MemoryArena* arena,
+    void* data,
+    umm oldSize,
+    umm newSize,
+    umm alignment = MEMORY_ALIGNMENT
+) {
+    if (data == nullptr) {
+        return memoryArenaAllocateAligned(arena, newSize, alignment);
+    }
+
+    MemoryBlock* block = arena->last;
+    umm oldAligned = alignUp(oldSize, MEMORY_ALIGNMENT);
+    umm newAligned = alignUp(newSize, MEMORY_ALIGNMENT);
+
+    bool atHead = block != nullptr && byteOffset(data, oldAligned) == block->head;
+    if (atHead && arena->tempCount > 0) {
+        // NOTE(jan): The mark is only in this block if it lies between the
+        // block's data and its head.
+        u8* mark = (u8*)arena->tempMark;
+        bool markInBlock = mark >= (u8*)byteOffset(block, MemoryBlockDataOffset) &&
+                           mark <= (u8*)block->head;
+        if (markInBlock && (u8*)data < mark) atHead = false;
+    }
+
+    if (atHead) {
+        if (newAligned <= oldAligned) {
+            umm shrink = oldAligned - newAligned;
+            block->head = byteOffset(data, newAligned);
+            block->free += shrink;
+            arena->stats.used -= shrink;
+            return data;
+        }
+
+        umm grow = newAligned - oldAligned;
+        if (grow <= block->free) {
+            block->head = byteOffset(block->head, grow);
+            block->free -= grow;
+            memoryArenaUse(arena, grow);
+            if (arena->flags & MEMORY_ARENA_VIRTUAL) {
+                memoryArenaCommit(arena, block->head);
+            }
+            return data;
+        }
+    }
+
+    if (newSize <= oldSize) return data;
+
+    void* result = memoryArenaAllocateAligned(arena, newSize, alignment);
+    memcpy(result, data, oldSize);
+    return result;
+}
+
+#define memoryArenaAllocateStruct(arena, type) \
+    (type*)memoryArenaAllocateAligned(arena, sizeof(type), alignof(type))
+#define memoryArenaAllocateStructAligned(arena, type, alignment) \
+    (type*)memoryArenaAllocateAligned(arena, sizeof(type), alignment)
+#define memoryArenaAllocateArray(arena, type, count) \
+    (type*)memoryArenaAllocateAligned(arena, sizeof(type) * (count), alignof(type))
 
 void
 memoryArenaClear(MemoryArena* arena) {
@@ -90,36 +655,302 @@ memoryArenaClear(MemoryArena* arena) {
 
     if (block == nullptr) return;
 
-    do {
-        MemoryBlock* next = block->next;
-        free(block);
-        block = next;
-    } while (block != nullptr);
+    if (arena->flags & MEMORY_ARENA_VIRTUAL) {
+        memoryRelease(block, arena->reserve);
+        arena->committed = 0;
+    } else {
+        do {
+            MemoryBlock* next = block->next;
+            memoryArenaReleaseBlock(arena, block);
+            block = next;
+        } while (block != nullptr);
+    }
 
     arena->first = nullptr;
     arena->last = nullptr;
+    arena->size = 0;
+    memset(arena->tails, 0, sizeof(arena->tails));
+
+    umm peak = arena->stats.peak;
+    arena->stats = {};
+    arena->stats.peak = peak;
 }
 
-umm
-getMemoryArenaFree(MemoryArena* arena) {
-    MemoryBlock* block = arena->first;
+// NOTE(jan): Like memoryArenaClear, but keeps the arena's blocks so that
+// refilling it does not go back to the heap.
+void
+memoryArenaReset(MemoryArena* arena) {
+    assert(arena->tempCount == 0);
 
-    umm result = 0;
+    MemoryBlock* block = arena->first;
     while (block != nullptr) {
-        result += block->free;
+        memoryBlockReset(block);
+        block->bucket = -1;
         block = block->next;
     }
+
+    arena->last = arena->first;
+    memset(arena->tails, 0, sizeof(arena->tails));
+
+    arena->stats.used = arena->stats.blockCount * MemoryBlockDataOffset;
+    arena->stats.padding = 0;
+    arena->stats.tailWaste = 0;
+}
+
+// NOTE(jan): Marks the arena so that everything allocated after the mark can
+// be released in one go. Blocks are kept for reuse rather than freed.
+struct MemoryArenaTemp {
+    MemoryArena* arena;
+    MemoryBlock* block;
+    void* head;
+    umm free;
+    MemoryArenaStats stats;
+    void* mark;
+    u32 depth;
+};
+
+MemoryArenaTemp
+memoryArenaBeginTemp(MemoryArena* arena) {
+    MemoryArenaTemp result = {};
+    result.arena = arena;
+    result.block = arena->last;
+    if (result.block) {
+        result.head = result.block->head;
+        result.free = result.block->free;
+    }
+    result.stats = arena->stats;
+    result.mark = arena->tempMark;
+    result.depth = ++arena->tempCount;
+    arena->tempMark = result.head;
     return result;
 }
 
+void
+memoryArenaEndTemp(MemoryArenaTemp temp) {
+    MemoryArena* arena = temp.arena;
+
+    // NOTE(jan): Temps must be ended in the reverse order they were begun.
+    assert(temp.depth == arena->tempCount);
+
+    // NOTE(jan): Tails are not reused inside a temp, so only blocks from the
+    // mark onwards can have been indexed since it was taken.
+    MemoryBlock* block = temp.block;
+    if (block) {
+        memoryArenaUnindexTail(arena, block);
+        block->head = temp.head;
+        block->free = temp.free;
+        block = block->next;
+        arena->last = temp.block;
+    } else {
+        block = arena->first;
+        arena->last = arena->first;
+    }
+
+    while (block != nullptr) {
+        memoryArenaUnindexTail(arena, block);
+        memoryBlockReset(block);
+        block = block->next;
+    }
+
+    // NOTE(jan): Blocks acquired since the mark are kept, and so are their headers.
+    umm newBlocks = arena->stats.blockCount - temp.stats.blockCount;
+    arena->stats.used = temp.stats.used + newBlocks * MemoryBlockDataOffset;
+    arena->stats.padding = temp.stats.padding;
+    arena->stats.tailWaste = temp.stats.tailWaste;
+
+    arena->tempMark = temp.mark;
+    arena->tempCount--;
+}
+
+struct MemoryArenaScope {
+    MemoryArenaTemp temp;
+
+    MemoryArenaScope(MemoryArena* arena): temp(memoryArenaBeginTemp(arena)) {}
+    ~MemoryArenaScope() { memoryArenaEndTemp(temp); }
+};
+
+umm
+getMemoryArenaFree(MemoryArena* arena) {
+    return arena->size - arena->stats.used;
+}
+
 umm
 getMemoryArenaUsed(MemoryArena* arena) {
-    MemoryBlock* block = arena->first;
+    return arena->stats.used;
+}
+
+void
+logMemoryArenaStats(const char* name, MemoryArena* arena) {
+    INFO(
+        "arena %s: %llu/%llu bytes used (peak %llu) in %llu block(s), %llu padding, %llu in block tails, %llu recovered from tails",
+        name,
+        (u64)arena->stats.used,
+        (u64)arena->size,
+        (u64)arena->stats.peak,
+        (u64)arena->stats.blockCount,
+        (u64)arena->stats.padding,
+        (u64)arena->stats.tailWaste,
+        (u64)arena->stats.recovered
+    );
+}
+
+// NOTE(jan): Child arenas are meant to be handed to worker threads. They are
+// not thread safe themselves, but take their blocks from the shared parent.
+// Their memory is only returned when the parent is cleared, so reset rather
+// than clear them between uses.
+void
+memoryArenaInitChild(MemoryArena* arena, SharedMemoryArena* parent) {
+    *arena = {};
+    arena->parent = parent;
+}
+
+SharedMemoryBlock*
+sharedMemoryArenaAllocateBlock(umm size) {
+    size = max(SHARED_MIN_BLOCK_SIZE, size);
+    void* data = malloc(size);
+    memoryHeapCounters.mallocs++;
+
+    if (!data) {
+        FATAL("Could not allocate block of size %llu", (u64)size);
+    }
+
+    auto* block = (SharedMemoryBlock*)data;
+    block->next = nullptr;
+    block->size = size;
+    new (&block->used) std::atomic<umm>(0);
+
+    return block;
+}
+
+void*
+sharedMemoryArenaAllocate(SharedMemoryArena* arena, umm size, umm alignment) {
+    if (alignment < MEMORY_ALIGNMENT) alignment = MEMORY_ALIGNMENT;
+    if (!isPowerOfTwo(alignment)) {
+        FATAL("alignment %llu is not a power of two", (u64)alignment);
+    }
+
+    // NOTE(jan): Offsets stay multiples of MEMORY_ALIGNMENT, so at most
+    // alignment - MEMORY_ALIGNMENT bytes of padding are needed.
+    umm reserve = alignUp(size, MEMORY_ALIGNMENT) + alignment - MEMORY_ALIGNMENT;
+
+    while (true) {
+        SharedMemoryBlock* block = arena->current.load(std::memory_order_acquire);
 
-    umm result = 0;
+        if (block != nullptr) {
+            umm offset = block->used.fetch_add(reserve, std::memory_order_relaxed);
+            if (offset + reserve <= block->size - SharedMemoryBlockDataOffset) {
+                umm start = (umm)block + SharedMemoryBlockDataOffset + offset;
+                return (void*)alignUp(start, alignment);
+            }
+        }
+
+        // NOTE(jan): Whoever gets the lock first replaces the block, the rest
+        // retry on the new one.
+        std::lock_guard<std::mutex> guard(arena->lock);
+        if (arena->current.load(std::memory_order_relaxed) == block) {
+            SharedMemoryBlock* newBlock = sharedMemoryArenaAllocateBlock(
+                SharedMemoryBlockDataOffset + reserve
+            );
+            newBlock->next = arena->first;
+            arena->first = newBlock;
+            arena->size += newBlock->size;
+            arena->current.store(newBlock, std::memory_order_release);
+        }
+    }
+}
+
+#define sharedMemoryArenaAllocateStruct(arena, type) \
+    (type*)sharedMemoryArenaAllocate(arena, sizeof(type), alignof(type))
+
+// NOTE(jan): Not thread safe, every user of the arena (including child
+// arenas) must be done with it.
+void
+sharedMemoryArenaClear(SharedMemoryArena* arena) {
+    SharedMemoryBlock* block = arena->first;
     while (block != nullptr) {
-        result += block->size - block->free;
-        block = block->next;
+        SharedMemoryBlock* next = block->next;
+        free(block);
+        memoryHeapCounters.frees++;
+        block = next;
+    }
+
+    arena->first = nullptr;
+    arena->current.store(nullptr);
+    arena->size = 0;
+}
+
+// NOTE(jan): Per-thread arena for short lived allocations. Only use it inside
+// a MemoryArenaScope, so that it is rewound when the caller is done.
+thread_local MemoryArena scratchArena;
+
+// NOTE(jan): Compile with MEMORY_ARENA_HISTOGRAM to count allocations and
+// bytes per call site. Everything allocated through the array and struct
+// macros is attributed to the file that expands them.
+#ifdef MEMORY_ARENA_HISTOGRAM
+#define MEMORY_ARENA_HISTOGRAM_SIZE 1024
+
+struct MemoryArenaCallSite {
+    const char* file;
+    int line;
+    u64 count;
+    u64 bytes;
+};
+
+struct MemoryArenaHistogram {
+    MemoryArenaCallSite sites[MEMORY_ARENA_HISTOGRAM_SIZE];
+    umm count;
+    std::mutex lock;
+};
+
+MemoryArenaHistogram memoryArenaHistogram;
+
+void*
+memoryArenaAllocateTracked(
+    MemoryArena* arena,
+    umm size,
+    umm alignment,
+    const char* file,
+    int line
+) {
+    {
+        std::lock_guard<std::mutex> guard(memoryArenaHistogram.lock);
+        umm hash = ((umm)file * 31 + line) * 0x9e3779b97f4a7c15ull;
+        umm index = (hash >> 32) % MEMORY_ARENA_HISTOGRAM_SIZE;
+        for (umm probe = 0; probe < MEMORY_ARENA_HISTOGRAM_SIZE; probe++) {
+            auto& site = memoryArenaHistogram.sites[index];
+            if (site.file == nullptr) {
+                site.file = file;
+                site.line = line;
+                memoryArenaHistogram.count++;
+            }
+            if ((site.file == file) && (site.line == line)) {
+                site.count++;
+                site.bytes += size;
+                break;
+            }
+            index = (index + 1) % MEMORY_ARENA_HISTOGRAM_SIZE;
+        }
+    }
+    return memoryArenaAllocateAligned(arena, size, alignment);
+}
+
+void
+logMemoryArenaHistogram() {
+    std::lock_guard<std::mutex> guard(memoryArenaHistogram.lock);
+    for (auto& site: memoryArenaHistogram.sites) {
+        if (site.file == nullptr) continue;
+        INFO(
+            "arena allocations at %s:%d: %llu call(s), %llu bytes",
+            site.file,
+            site.line,
+            site.count,
+            site.bytes
+        );
     }
-    return result;
 }
+
+#define memoryArenaAllocateAligned(arena, size, alignment) \
+    memoryArenaAllocateTracked(arena, size, alignment, __FILE__, __LINE__)
+#define memoryArenaAllocate(arena, size) \
+    memoryArenaAllocateTracked(arena, size, MEMORY_ALIGNMENT, __FILE__, __LINE__)
+#endif
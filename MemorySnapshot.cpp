@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdio.h>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+#include "Memory.cpp"
+
+// NOTE(jan): Saves the contents of a virtual arena to a file and maps them
+// back on a later run. Nothing is relocated, so the arena is restored at the
+// address it was saved from; reserve it with a fixed base. Pointers within
+// the arena survive the round trip, pointers out of it do not, and the
+// snapshot is only valid for the build that wrote it.
+//
+// The header is padded to VIRTUAL_COMMIT_SIZE, which is a multiple of the
+// page size and of the Windows allocation granularity, so that the data can
+// be mapped straight from the file.
+
+const u32 MEMORY_SNAPSHOT_MAGIC = 0x414e5241;
+const u32 MEMORY_SNAPSHOT_VERSION = 1;
+
+struct MemorySnapshotHeader {
+    u32 magic;
+    u32 version;
+    u32 flags;
+    u32 blockHeaderSize;
+    u64 base;
+    u64 reserve;
+    // NOTE(jan): Bytes of arena data after the header, a multiple of
+    // VIRTUAL_COMMIT_SIZE.
+    u64 size;
+    MemoryArenaStats stats;
+};
+
+FILE*
+memorySnapshotOpen(const char* path, const char* mode) {
+    FILE* result = nullptr;
+#ifdef WIN32
+    if (fopen_s(&result, path, mode) != 0) result = nullptr;
+#else
+    result = fopen(path, mode);
+#endif
+    return result;
+}
+
+bool
+memoryArenaSave(MemoryArena* arena, const char* path) {
+    if (!(arena->flags & MEMORY_ARENA_VIRTUAL) || arena->first == nullptr) {
+        ERR("can only save virtual arenas that have been allocated from");
+        return false;
+    }
+
+    MemoryBlock* block = arena->first;
+    umm used = (umm)block->head - (umm)block;
+
+    MemorySnapshotHeader header = {};
+    header.magic = MEMORY_SNAPSHOT_MAGIC;
+    header.version = MEMORY_SNAPSHOT_VERSION;
+    header.flags = arena->flags;
+    header.blockHeaderSize = (u32)MemoryBlockDataOffset;
+    header.base = (u64)block;
+    header.reserve = arena->reserve;
+    // NOTE(jan): Everything up to here is committed, see memoryArenaCommit.
+    header.size = alignUp(used, VIRTUAL_COMMIT_SIZE);
+    header.stats = arena->stats;
+
+    FILE* file = memorySnapshotOpen(path, "wb");
+    if (file == nullptr) {
+        ERR("could not open %s for writing", path);
+        return false;
+    }
+
+    bool result = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fseek(file, (long)VIRTUAL_COMMIT_SIZE, SEEK_SET) == 0 &&
+                  fwrite(block, 1, header.size, file) == header.size;
+    result = fclose(file) == 0 && result;
+
+    if (!result) {
+        ERR("could not write arena snapshot to %s", path);
+    }
+    return result;
+}
+
+// NOTE(jan): Returns false if there is no usable snapshot at path, in which
+// case the arena is left untouched and should be rebuilt.
+bool
+memoryArenaLoad(MemoryArena* arena, const char* path) {
+    FILE* file = memorySnapshotOpen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    MemorySnapshotHeader header = {};
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != MEMORY_SNAPSHOT_MAGIC ||
+        header.version != MEMORY_SNAPSHOT_VERSION ||
+        header.blockHeaderSize != MemoryBlockDataOffset ||
+        header.size > header.reserve) {
+        WARN("%s is not a compatible arena snapshot", path);
+        fclose(file);
+        return false;
+    }
+
+#ifndef WIN32
+    // NOTE(jan): Touching a mapped page past the end of the file raises
+    // SIGBUS, so a truncated snapshot has to be caught here.
+    struct stat status;
+    if (fstat(fileno(file), &status) != 0 ||
+        (u64)status.st_size < VIRTUAL_COMMIT_SIZE + header.size) {
+        WARN("%s is truncated", path);
+        fclose(file);
+        return false;
+    }
+#endif
+
+    void* base = (void*)header.base;
+    void* data = memoryReserve(header.reserve, base);
+    if (data == nullptr) {
+        WARN("could not reserve %llu bytes at %p for %s", (unsigned long long)header.reserve, base, path);
+        fclose(file);
+        return false;
+    }
+
+#ifdef WIN32
+    bool loaded = memoryCommit(data, header.size) &&
+                  fseek(file, (long)VIRTUAL_COMMIT_SIZE, SEEK_SET) == 0 &&
+                  fread(data, 1, header.size, file) == header.size;
+#else
+    // NOTE(jan): A private mapping, so pages are only read in when touched
+    // and writes to the arena never reach the file.
+    void* mapped = mmap(
+        data,
+        header.size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_FIXED,
+        fileno(file),
+        VIRTUAL_COMMIT_SIZE
+    );
+    bool loaded = mapped == data;
+#endif
+    fclose(file);
+
+    if (!loaded) {
+        WARN("could not load arena snapshot from %s", path);
+        memoryRelease(data, header.reserve);
+        return false;
+    }
+
+    *arena = {};
+    arena->flags = header.flags;
+    arena->reserve = header.reserve;
+    arena->committed = header.size;
+    arena->base = base;
+    arena->first = (MemoryBlock*)data;
+    arena->last = arena->first;
+    arena->size = arena->first->size;
+    arena->stats = header.stats;
+
+    return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <new>
+
+#include "Memory.cpp"
+
+// NOTE(jan): Fixed size objects carved out of slabs in a MemoryArena. Freed
+// slots go onto an intrusive free list, so allocating and freeing are O(1).
+// Slabs are never returned to the arena.
+
+const umm POOL_SLAB_COUNT = 64;
+
+template<typename T>
+struct PoolSlot {
+    union {
+        T value;
+        PoolSlot<T>* nextFree;
+    };
+    // NOTE(jan): Bumped on every allocate and free, so it is odd while the slot
+    // is free. Handles hold the even value from when they were made, so a
+    // stale one never matches.
+    u32 generation;
+};
+
+template<typename T>
+struct Pool {
+    MemoryArena* arena;
+    PoolSlot<T>* freeList;
+    umm slabCount;
+    umm count;
+    umm capacity;
+};
+
+template<typename T>
+struct PoolHandle {
+    PoolSlot<T>* slot;
+    u32 generation;
+};
+
+template<typename T>
+void
+poolInit(Pool<T>* pool, MemoryArena* arena, umm slabCount = POOL_SLAB_COUNT) {
+    *pool = {};
+    pool->arena = arena;
+    pool->slabCount = slabCount;
+}
+
+template<typename T>
+void
+poolGrow(Pool<T>* pool) {
+    auto* slab = memoryArenaAllocateArray(pool->arena, PoolSlot<T>, pool->slabCount);
+
+    // NOTE(jan): Pushed in reverse so that slots are handed out in address order.
+    for (umm i = pool->slabCount; i > 0; i--) {
+        PoolSlot<T>* slot = slab + i - 1;
+        slot->generation = 1;
+        slot->nextFree = pool->freeList;
+        pool->freeList = slot;
+    }
+
+    pool->capacity += pool->slabCount;
+}
+
+template<typename T>
+T*
+poolAllocate(Pool<T>* pool) {
+    if (pool->freeList == nullptr) {
+        poolGrow(pool);
+    }
+
+    PoolSlot<T>* slot = pool->freeList;
+    pool->freeList = slot->nextFree;
+    slot->generation++;
+    pool->count++;
+
+    return new (&slot->value) T();
+}
+
+// NOTE(jan): Freeing an item twice asserts in debug builds.
+template<typename T>
+void
+poolFree(Pool<T>* pool, T* item) {
+    auto* slot = (PoolSlot<T>*)item;
+    assert((slot->generation & 1) == 0);
+    item->~T();
+
+    slot->generation++;
+    slot->nextFree = pool->freeList;
+    pool->freeList = slot;
+    pool->count--;
+}
+
+template<typename T>
+PoolHandle<T>
+poolAllocateHandle(Pool<T>* pool) {
+    T* item = poolAllocate(pool);
+    auto* slot = (PoolSlot<T>*)item;
+
+    PoolHandle<T> result = {};
+    result.slot = slot;
+    result.generation = slot->generation;
+    return result;
+}
+
+// NOTE(jan): Returns nullptr for handles whose object has since been freed.
+template<typename T>
+T*
+poolGet(Pool<T>* pool, PoolHandle<T> handle) {
+    if (handle.slot == nullptr) return nullptr;
+    if (handle.slot->generation != handle.generation) return nullptr;
+    return &handle.slot->value;
+}
+
+template<typename T>
+void
+poolFreeHandle(Pool<T>* pool, PoolHandle<T> handle) {
+    T* item = poolGet(pool, handle);
+    if (item != nullptr) {
+        poolFree(pool, item);
+    }
+}
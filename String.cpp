@@ -1,27 +1,37 @@
+#pragma once
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <vector>
 
+// NOTE(jan): Define STRING_NO_SIMD to use the scalar reference paths only.
+#if defined(STRING_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define STRING_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRING_SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define STRING_SIMD_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "Array.cpp"
+#include "HashMap.cpp"
 #include "Types.h"
 #include "Memory.cpp"
 
 using std::string;
 using std::vector;
 
-static inline void
-cStringToVecOfStrings(
-    char* cstr,
-    vector<string>& vec
-) {
-    auto delim = " ";
-    char* token = strtok(cstr, delim);
-    while (token != nullptr) {
-        string s(token);
-        vec.push_back(s);
-        token = strtok(NULL, delim);
-    }
-}
-
 struct String {
     umm size;
     umm length;
@@ -49,3 +59,806 @@ stringLiteral(const char* s) {
     
     return result;
 }
+
+// NOTE(jan): A view of length bytes at data, which is not copied and need not
+// be NUL terminated.
+struct String
+stringView(const char* data, umm length) {
+    struct String result = {
+        .size = length,
+        .length = length,
+        .data = (char*)data
+    };
+
+    return result;
+}
+
+// NOTE(jan): Scanning functions work on chunks of this many bytes and get a
+// bit mask per chunk, one bit per byte.
+#if defined(STRING_SIMD_AVX2)
+const umm STRING_CHUNK_SIZE = 32;
+#else
+const umm STRING_CHUNK_SIZE = 16;
+#endif
+const u32 STRING_CHUNK_MASK = STRING_CHUNK_SIZE == 32 ? 0xffffffff : (1u << STRING_CHUNK_SIZE) - 1;
+
+inline u32
+countTrailingZeros(u32 x) {
+#ifdef _MSC_VER
+    unsigned long result;
+    _BitScanForward(&result, x);
+    return result;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+#if defined(STRING_SIMD_NEON)
+// NOTE(jan): NEON has no movemask, so weight each lane by its bit and sum
+// the halves.
+inline u32
+stringNeonMask(uint8x16_t lanes) {
+    static const u8 weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t bits = vandq_u8(lanes, vld1q_u8(weights));
+    return (u32)vaddv_u8(vget_low_u8(bits)) | ((u32)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+#endif
+
+// NOTE(jan): Up to this many delimiters are compared with SIMD, more than
+// that go through the lookup table a byte at a time.
+const u32 STRING_MAX_SIMD_DELIMITERS = 8;
+
+struct StringDelimiters {
+    u8 bytes[STRING_MAX_SIMD_DELIMITERS];
+    u32 count;
+    bool table[256];
+};
+
+StringDelimiters
+stringDelimiters(const char* delimiters) {
+    StringDelimiters result = {};
+    for (const char* c = delimiters; *c; c++) {
+        u8 byte = (u8)*c;
+        if (result.table[byte]) continue;
+        result.table[byte] = true;
+        if (result.count < STRING_MAX_SIMD_DELIMITERS) {
+            result.bytes[result.count] = byte;
+        }
+        result.count++;
+    }
+    return result;
+}
+
+// NOTE(jan): Bits for bytes past length are set, so a chunk at the end of a
+// string reads as ending in delimiters.
+inline u32
+stringDelimiterMaskScalar(const char* data, umm length, const StringDelimiters* delimiters) {
+    u32 result = STRING_CHUNK_MASK;
+    if (length > STRING_CHUNK_SIZE) length = STRING_CHUNK_SIZE;
+    for (umm i = 0; i < length; i++) {
+        if (!delimiters->table[(u8)data[i]]) result &= ~(1u << i);
+    }
+    return result;
+}
+
+// NOTE(jan): Reads a whole chunk at data.
+inline u32
+stringDelimiterMask(const char* data, const StringDelimiters* delimiters) {
+    if (delimiters->count > STRING_MAX_SIMD_DELIMITERS) {
+        return stringDelimiterMaskScalar(data, STRING_CHUNK_SIZE, delimiters);
+    }
+#if defined(STRING_SIMD_AVX2)
+    __m256i chunk = _mm256_loadu_si256((const __m256i*)data);
+    __m256i hits = _mm256_setzero_si256();
+    for (u32 i = 0; i < delimiters->count; i++) {
+        __m256i delimiter = _mm256_set1_epi8((char)delimiters->bytes[i]);
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, delimiter));
+    }
+    return (u32)_mm256_movemask_epi8(hits);
+#elif defined(STRING_SIMD_SSE2)
+    __m128i chunk = _mm_loadu_si128((const __m128i*)data);
+    __m128i hits = _mm_setzero_si128();
+    for (u32 i = 0; i < delimiters->count; i++) {
+        __m128i delimiter = _mm_set1_epi8((char)delimiters->bytes[i]);
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, delimiter));
+    }
+    return (u32)_mm_movemask_epi8(hits);
+#elif defined(STRING_SIMD_NEON)
+    uint8x16_t chunk = vld1q_u8((const u8*)data);
+    uint8x16_t hits = vdupq_n_u8(0);
+    for (u32 i = 0; i < delimiters->count; i++) {
+        hits = vorrq_u8(hits, vceqq_u8(chunk, vdupq_n_u8(delimiters->bytes[i])));
+    }
+    return stringNeonMask(hits);
+#else
+    return stringDelimiterMaskScalar(data, STRING_CHUNK_SIZE, delimiters);
+#endif
+}
+
+// NOTE(jan): Appends a view of every run of non-delimiter bytes in s to
+// tokens. Like strtok, empty tokens are skipped, but s is left untouched.
+void
+stringTokenize(Array<String>* tokens, String s, const StringDelimiters* delimiters) {
+    // NOTE(jan): Whether the byte before the current chunk was a delimiter.
+    u32 carry = 1;
+    umm start = 0;
+
+    for (umm i = 0; i < s.length; i += STRING_CHUNK_SIZE) {
+        umm remaining = s.length - i;
+        u32 mask = remaining >= STRING_CHUNK_SIZE ?
+            stringDelimiterMask(s.data + i, delimiters) :
+            stringDelimiterMaskScalar(s.data + i, remaining, delimiters);
+
+        // NOTE(jan): A bit is set wherever a byte differs from the one before
+        // it, which is where tokens start and end.
+        u32 edges = (mask ^ ((mask << 1) | carry)) & STRING_CHUNK_MASK;
+        while (edges) {
+            u32 bit = countTrailingZeros(edges);
+            edges &= edges - 1;
+            if (mask & (1u << bit)) {
+                arrayPush(tokens, stringView(s.data + start, i + bit - start));
+            } else {
+                start = i + bit;
+            }
+        }
+        carry = (mask >> (STRING_CHUNK_SIZE - 1)) & 1;
+    }
+
+    // NOTE(jan): Only reached if s ends on a chunk boundary inside a token.
+    if (!carry) {
+        arrayPush(tokens, stringView(s.data + start, s.length - start));
+    }
+}
+
+Array<String>
+stringTokenize(MemoryArena* arena, String s, const char* delimiters) {
+    StringDelimiters set = stringDelimiters(delimiters);
+    Array<String> result = arrayCreate<String>(arena);
+    stringTokenize(&result, s, &set);
+    return result;
+}
+
+static inline void
+cStringToVecOfStrings(
+    const char* cstr,
+    vector<string>& vec
+) {
+    MemoryArenaScope scratch(&scratchArena);
+    auto tokens = stringTokenize(&scratchArena, stringLiteral(cstr), " ");
+    for (auto& token: tokens) {
+        vec.emplace_back(token.data, token.length);
+    }
+}
+
+// NOTE(jan): View operations. None of these copy or modify the bytes they are
+// given, and results that are strings are views into their inputs. Each SIMD
+// kernel has a scalar version that takes a length, which handles the tail of
+// a string and is the reference when STRING_NO_SIMD is defined.
+
+// NOTE(jan): Returned by the find functions when there is no match.
+const umm STRING_NOT_FOUND = (umm)-1;
+
+inline u8
+asciiToLower(u8 c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+inline bool
+asciiIsSpace(u8 c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// NOTE(jan): Bit i is set if data[i] is byte. Bits past length are clear.
+inline u32
+stringMatchMaskScalar(const char* data, umm length, u8 byte) {
+    u32 result = 0;
+    if (length > STRING_CHUNK_SIZE) length = STRING_CHUNK_SIZE;
+    for (umm i = 0; i < length; i++) {
+        if ((u8)data[i] == byte) result |= 1u << i;
+    }
+    return result;
+}
+
+// NOTE(jan): Bit i is set if a[i] and b[i] differ, after folding ASCII case
+// if ignoreCase is set. Bits past length are clear.
+inline u32
+stringDifferMaskScalar(const char* a, const char* b, umm length, bool ignoreCase) {
+    u32 result = 0;
+    if (length > STRING_CHUNK_SIZE) length = STRING_CHUNK_SIZE;
+    for (umm i = 0; i < length; i++) {
+        u8 x = (u8)a[i];
+        u8 y = (u8)b[i];
+        if (ignoreCase) {
+            x = asciiToLower(x);
+            y = asciiToLower(y);
+        }
+        if (x != y) result |= 1u << i;
+    }
+    return result;
+}
+
+// NOTE(jan): Bytes of 0x80 and up are negative as signed bytes, so they are
+// never in the range and are left alone.
+#if defined(STRING_SIMD_AVX2)
+inline __m256i
+stringLowerChunk(__m256i chunk) {
+    __m256i upper = _mm256_and_si256(
+        _mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('A' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), chunk)
+    );
+    return _mm256_or_si256(chunk, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+#elif defined(STRING_SIMD_SSE2)
+inline __m128i
+stringLowerChunk(__m128i chunk) {
+    __m128i upper = _mm_and_si128(
+        _mm_cmpgt_epi8(chunk, _mm_set1_epi8('A' - 1)),
+        _mm_cmplt_epi8(chunk, _mm_set1_epi8('Z' + 1))
+    );
+    return _mm_or_si128(chunk, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#elif defined(STRING_SIMD_NEON)
+inline uint8x16_t
+stringLowerChunk(uint8x16_t chunk) {
+    uint8x16_t upper = vandq_u8(vcgeq_u8(chunk, vdupq_n_u8('A')), vcleq_u8(chunk, vdupq_n_u8('Z')));
+    return vorrq_u8(chunk, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+#endif
+
+// NOTE(jan): Reads a whole chunk at data.
+inline u32
+stringMatchMask(const char* data, u8 byte) {
+#if defined(STRING_SIMD_AVX2)
+    __m256i chunk = _mm256_loadu_si256((const __m256i*)data);
+    return (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8((char)byte)));
+#elif defined(STRING_SIMD_SSE2)
+    __m128i chunk = _mm_loadu_si128((const __m128i*)data);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)byte)));
+#elif defined(STRING_SIMD_NEON)
+    return stringNeonMask(vceqq_u8(vld1q_u8((const u8*)data), vdupq_n_u8(byte)));
+#else
+    return stringMatchMaskScalar(data, STRING_CHUNK_SIZE, byte);
+#endif
+}
+
+// NOTE(jan): Reads a whole chunk at a and b.
+inline u32
+stringDifferMask(const char* a, const char* b, bool ignoreCase) {
+#if defined(STRING_SIMD_AVX2)
+    __m256i x = _mm256_loadu_si256((const __m256i*)a);
+    __m256i y = _mm256_loadu_si256((const __m256i*)b);
+    if (ignoreCase) {
+        x = stringLowerChunk(x);
+        y = stringLowerChunk(y);
+    }
+    return ~(u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+#elif defined(STRING_SIMD_SSE2)
+    __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i y = _mm_loadu_si128((const __m128i*)b);
+    if (ignoreCase) {
+        x = stringLowerChunk(x);
+        y = stringLowerChunk(y);
+    }
+    return ~(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & STRING_CHUNK_MASK;
+#elif defined(STRING_SIMD_NEON)
+    uint8x16_t x = vld1q_u8((const u8*)a);
+    uint8x16_t y = vld1q_u8((const u8*)b);
+    if (ignoreCase) {
+        x = stringLowerChunk(x);
+        y = stringLowerChunk(y);
+    }
+    return stringNeonMask(vmvnq_u8(vceqq_u8(x, y)));
+#else
+    return stringDifferMaskScalar(a, b, STRING_CHUNK_SIZE, ignoreCase);
+#endif
+}
+
+// NOTE(jan): Clamped to s, so out of range bounds give an empty view.
+struct String
+stringSlice(String s, umm start, umm end) {
+    if (end > s.length) end = s.length;
+    if (start > end) start = end;
+    return stringView(s.data + start, end - start);
+}
+
+umm
+stringFindChar(String s, char c, umm from = 0) {
+    for (umm i = from; i < s.length; i += STRING_CHUNK_SIZE) {
+        umm remaining = s.length - i;
+        u32 mask = remaining >= STRING_CHUNK_SIZE ?
+            stringMatchMask(s.data + i, (u8)c) :
+            stringMatchMaskScalar(s.data + i, remaining, (u8)c);
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return STRING_NOT_FOUND;
+}
+
+umm
+stringFind(String s, String needle, umm from = 0) {
+    if (needle.length == 0) return from <= s.length ? from : STRING_NOT_FOUND;
+    if (needle.length == 1) return stringFindChar(s, needle.data[0], from);
+    if (needle.length > s.length) return STRING_NOT_FOUND;
+
+    // NOTE(jan): Positions where both the first and the last byte of the
+    // needle match are candidates, and only those are compared in full.
+    umm last = s.length - needle.length;
+    u8 head = (u8)needle.data[0];
+    u8 tail = (u8)needle.data[needle.length - 1];
+    umm i = from;
+    for (; i + STRING_CHUNK_SIZE <= last + 1; i += STRING_CHUNK_SIZE) {
+        u32 mask = stringMatchMask(s.data + i, head) &
+                   stringMatchMask(s.data + i + needle.length - 1, tail);
+        while (mask) {
+            u32 bit = countTrailingZeros(mask);
+            mask &= mask - 1;
+            if (memcmp(s.data + i + bit + 1, needle.data + 1, needle.length - 2) == 0) {
+                return i + bit;
+            }
+        }
+    }
+    for (; i <= last; i++) {
+        if ((u8)s.data[i] == head && memcmp(s.data + i, needle.data, needle.length) == 0) {
+            return i;
+        }
+    }
+    return STRING_NOT_FOUND;
+}
+
+umm
+stringFind(String s, const char* needle, umm from = 0) {
+    return stringFind(s, stringLiteral(needle), from);
+}
+
+// NOTE(jan): Unlike stringTokenize, empty fields are kept, so n separators
+// always give n + 1 views.
+Array<String>
+stringSplit(MemoryArena* arena, String s, char separator) {
+    Array<String> result = arrayCreate<String>(arena);
+    umm start = 0;
+    while (true) {
+        umm end = stringFindChar(s, separator, start);
+        if (end == STRING_NOT_FOUND) break;
+        arrayPush(&result, stringSlice(s, start, end));
+        start = end + 1;
+    }
+    arrayPush(&result, stringSlice(s, start, s.length));
+    return result;
+}
+
+struct String
+stringTrimLeft(String s) {
+    umm start = 0;
+    while (start < s.length && asciiIsSpace((u8)s.data[start])) start++;
+    return stringSlice(s, start, s.length);
+}
+
+struct String
+stringTrimRight(String s) {
+    umm end = s.length;
+    while (end > 0 && asciiIsSpace((u8)s.data[end - 1])) end--;
+    return stringSlice(s, 0, end);
+}
+
+struct String
+stringTrim(String s) {
+    return stringTrimRight(stringTrimLeft(s));
+}
+
+bool
+stringStartsWith(String s, String prefix) {
+    return s.length >= prefix.length &&
+        memcmp(s.data, prefix.data, prefix.length) == 0;
+}
+
+bool
+stringEndsWith(String s, String suffix) {
+    return s.length >= suffix.length &&
+        memcmp(s.data + s.length - suffix.length, suffix.data, suffix.length) == 0;
+}
+
+bool
+stringEquals(String a, String b) {
+    return a.length == b.length && memcmp(a.data, b.data, a.length) == 0;
+}
+
+inline bool operator==(String a, String b) { return stringEquals(a, b); }
+
+// NOTE(jan): Orders like strcmp after folding ASCII case. Other bytes are
+// compared as unsigned.
+int
+stringCompareIgnoreCase(String a, String b) {
+    umm length = a.length < b.length ? a.length : b.length;
+    for (umm i = 0; i < length; i += STRING_CHUNK_SIZE) {
+        umm remaining = length - i;
+        u32 mask = remaining >= STRING_CHUNK_SIZE ?
+            stringDifferMask(a.data + i, b.data + i, true) :
+            stringDifferMaskScalar(a.data + i, b.data + i, remaining, true);
+        if (mask) {
+            umm j = i + countTrailingZeros(mask);
+            return (int)asciiToLower((u8)a.data[j]) - (int)asciiToLower((u8)b.data[j]);
+        }
+    }
+    if (a.length == b.length) return 0;
+    return a.length < b.length ? -1 : 1;
+}
+
+bool
+stringEqualsIgnoreCase(String a, String b) {
+    return a.length == b.length && stringCompareIgnoreCase(a, b) == 0;
+}
+
+inline u64
+stringHash(String s) {
+    return hashBytes(s.data, s.length);
+}
+
+inline u64 hashKey(String key) { return stringHash(key); }
+
+// NOTE(jan): Folds ASCII case in all 8 bytes of word at once. No byte can
+// carry into the next, since the high bits are masked off before adding.
+inline u64
+asciiToLower8(u64 word) {
+    const u64 ones = 0x0101010101010101ull;
+    u64 low = word & (0x7f * ones);
+    u64 atLeastA = low + (0x80 - 'A') * ones;
+    u64 aboveZ = low + (0x80 - 'Z' - 1) * ones;
+    u64 upper = (atLeastA ^ aboveZ) & ~word & (0x80 * ones);
+    return word | (upper >> 2);
+}
+
+// NOTE(jan): Mixes exactly like hashBytes, so it agrees with stringHash on
+// strings that have no upper case letters.
+u64
+stringHashIgnoreCase(String s) {
+    const u8* bytes = (const u8*)s.data;
+    umm length = s.length;
+    u64 result = 0x9e3779b97f4a7c15ull ^ length;
+    while (length >= 8) {
+        u64 word;
+        memcpy(&word, bytes, 8);
+        result = (result ^ asciiToLower8(word)) * 0xff51afd7ed558ccdull;
+        result ^= result >> 32;
+        bytes += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        u64 word = 0;
+        memcpy(&word, bytes, length);
+        result = (result ^ asciiToLower8(word)) * 0xff51afd7ed558ccdull;
+    }
+    return hashKey(result);
+}
+
+// NOTE(jan): Builder functions treat size as the capacity of data and keep
+// it NUL terminated, so the result can be handed to C APIs. Strings must be
+// empty or have been allocated from the arena they are grown in; growth is in
+// place if nothing else has been allocated from the arena since.
+void
+stringReserve(MemoryArena* arena, String* s, umm size) {
+    if (size <= s->size) return;
+
+    umm capacity = s->size * 2;
+    if (capacity < size) capacity = size;
+    if (capacity < 32) capacity = 32;
+
+    s->data = (char*)memoryArenaResize(arena, s->data, s->size, capacity, 1);
+    s->size = capacity;
+}
+
+void
+stringAppend(MemoryArena* arena, String* s, const char* data, umm length) {
+    stringReserve(arena, s, s->length + length + 1);
+    memcpy(s->data + s->length, data, length);
+    s->length += length;
+    s->data[s->length] = '\0';
+}
+
+void
+stringAppend(MemoryArena* arena, String* s, const char* cstr) {
+    stringAppend(arena, s, cstr, strlen(cstr));
+}
+
+void
+stringAppend(MemoryArena* arena, String* s, String other) {
+    stringAppend(arena, s, other.data, other.length);
+}
+
+void
+stringAppendChar(MemoryArena* arena, String* s, char c) {
+    stringAppend(arena, s, &c, 1);
+}
+
+void
+stringAppendU64(MemoryArena* arena, String* s, u64 value, u32 base = 10, u32 minDigits = 1) {
+    const char* digits = "0123456789abcdef";
+    char buffer[64];
+    char* end = buffer + sizeof(buffer);
+    char* start = end;
+    do {
+        *--start = digits[value % base];
+        value /= base;
+    } while (value != 0);
+    while ((umm)(end - start) < minDigits && start > buffer) {
+        *--start = '0';
+    }
+    stringAppend(arena, s, start, end - start);
+}
+
+void
+stringAppendS64(MemoryArena* arena, String* s, s64 value, u32 minDigits = 1) {
+    if (value < 0) {
+        stringAppendChar(arena, s, '-');
+        // NOTE(jan): Negated as unsigned so that INT64_MIN does not overflow.
+        stringAppendU64(arena, s, 0 - (u64)value, 10, minDigits);
+    } else {
+        stringAppendU64(arena, s, (u64)value, 10, minDigits);
+    }
+}
+
+// NOTE(jan): Fixed point, rounded as printf rounds: to the nearest, and to
+// even when the value is exactly halfway. Up to 9 decimals fit a u64 along
+// with the integer part, so more than that, and values of 1e15 and up, whose
+// integer digits a u64 does not hold exactly, go through snprintf.
+void
+stringAppendF64(MemoryArena* arena, String* s, f64 value, u32 precision = 6) {
+    if (isnan(value)) {
+        stringAppend(arena, s, "nan");
+        return;
+    }
+    if (signbit(value)) {
+        stringAppendChar(arena, s, '-');
+        value = -value;
+    }
+    if (isinf(value)) {
+        stringAppend(arena, s, "inf");
+        return;
+    }
+
+    if (value >= 1e15 || precision > 9) {
+        int needed = snprintf(nullptr, 0, "%.*f", (int)precision, value);
+        if (needed > 0) {
+            stringReserve(arena, s, s->length + needed + 1);
+            snprintf(s->data + s->length, needed + 1, "%.*f", (int)precision, value);
+            s->length += needed;
+        }
+        return;
+    }
+
+    u64 scale = 1;
+    for (u32 i = 0; i < precision; i++) scale *= 10;
+
+    // NOTE(jan): Both of these are exact. fma gives the sign of the scaled
+    // fraction's distance from each candidate without rounding it first, so a
+    // tie is only a tie if it really is one.
+    u64 whole = (u64)value;
+    f64 part = value - (f64)whole;
+    f64 digits = floor(part * (f64)scale);
+    if (fma(part, (f64)scale, -digits) < 0) digits -= 1;
+    f64 above = fma(part, (f64)scale, -(digits + 0.5));
+    u64 fraction = (u64)digits;
+    u64 last = precision ? fraction : whole;
+    if (above > 0 || (above == 0 && (last & 1))) fraction++;
+    if (fraction >= scale) {
+        whole++;
+        fraction -= scale;
+    }
+
+    stringAppendU64(arena, s, whole);
+    if (precision > 0) {
+        stringAppendChar(arena, s, '.');
+        stringAppendU64(arena, s, fraction, 10, precision);
+    }
+}
+
+// NOTE(jan): Pads the field that starts at start out to width, on the left
+// unless left is set. Zeros go after any sign or 0x prefix.
+void
+stringPadField(MemoryArena* arena, String* s, umm start, u32 width, bool left, bool zero) {
+    umm length = s->length - start;
+    if (length >= width) return;
+    umm padding = width - length;
+
+    if (left) {
+        for (umm i = 0; i < padding; i++) stringAppendChar(arena, s, ' ');
+        return;
+    }
+
+    umm at = start;
+    if (zero) {
+        if (at < s->length && s->data[at] == '-') at++;
+        if (at + 1 < s->length && s->data[at] == '0' && s->data[at + 1] == 'x') at += 2;
+    }
+    stringReserve(arena, s, s->length + padding + 1);
+    memmove(s->data + at + padding, s->data + at, s->length - at + 1);
+    memset(s->data + at, zero ? '0' : ' ', padding);
+    s->length += padding;
+    s->data[s->length] = '\0';
+}
+
+// NOTE(jan): Appends a printf subset that does not go through the C locale:
+// %% %c %s %d %i %u %x %X %p %f, the - and 0 flags, a width, a precision
+// (either may be *), the hh, h, l, ll and z length modifiers, and %S for a
+// String passed by value. From the first conversion outside of that on, the
+// rest of fmt is handed to vsnprintf.
+void
+stringFormatV(MemoryArena* arena, String* s, const char* fmt, va_list args) {
+    const char* run = fmt;
+    while (*fmt) {
+        if (*fmt != '%') {
+            fmt++;
+            continue;
+        }
+        if (fmt > run) stringAppend(arena, s, run, fmt - run);
+        fmt++;
+
+        bool left = false;
+        bool zero = false;
+        while (*fmt == '-' || *fmt == '0') {
+            if (*fmt == '-') left = true;
+            if (*fmt == '0') zero = true;
+            fmt++;
+        }
+
+        // NOTE(jan): Kept as written for the fallback; zero is cleared below
+        // where it does not apply to the conversions handled here.
+        bool zeroFlag = zero;
+        u32 width = 0;
+        if (*fmt == '*') {
+            int value = va_arg(args, int);
+            if (value < 0) {
+                left = true;
+                value = -value;
+            }
+            width = (u32)value;
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+        }
+
+        bool hasPrecision = false;
+        u32 precision = 0;
+        if (*fmt == '.') {
+            fmt++;
+            hasPrecision = true;
+            if (*fmt == '*') {
+                int value = va_arg(args, int);
+                if (value < 0) hasPrecision = false;
+                else precision = (u32)value;
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') precision = precision * 10 + (*fmt++ - '0');
+            }
+        }
+
+        const char* lengthStart = fmt;
+        char length = 0;
+        if (*fmt == 'z') {
+            length = 'z';
+            fmt++;
+        } else if (fmt[0] == 'l' && fmt[1] == 'l') {
+            length = 'L';
+            fmt += 2;
+        } else if (*fmt == 'l') {
+            length = 'l';
+            fmt++;
+        } else if (fmt[0] == 'h' && fmt[1] == 'h') {
+            length = 'H';
+            fmt += 2;
+        } else if (*fmt == 'h') {
+            length = 'h';
+            fmt++;
+        }
+
+        // NOTE(jan): Precision on integers is a minimum digit count, and turns
+        // off zero padding as in printf.
+        u32 minDigits = 1;
+        if (hasPrecision) {
+            minDigits = precision;
+            if (*fmt != 'f' && *fmt != 's' && *fmt != 'S') zero = false;
+        }
+
+        umm start = s->length;
+        bool numeric = true;
+        switch (*fmt) {
+            case '%': {
+                width = 0;
+                stringAppendChar(arena, s, '%');
+            } break;
+            case 'c': {
+                numeric = false;
+                stringAppendChar(arena, s, (char)va_arg(args, int));
+            } break;
+            case 's': {
+                numeric = false;
+                const char* value = va_arg(args, const char*);
+                if (!value) value = "(null)";
+                umm count = 0;
+                while (value[count] && (!hasPrecision || count < precision)) count++;
+                stringAppend(arena, s, value, count);
+            } break;
+            case 'S': {
+                numeric = false;
+                String value = va_arg(args, String);
+                if (hasPrecision && value.length > precision) value.length = precision;
+                stringAppend(arena, s, value);
+            } break;
+            case 'd':
+            case 'i': {
+                s64 value = length == 'L' ? va_arg(args, long long) :
+                            length == 'l' ? va_arg(args, long) :
+                            length == 'z' ? (s64)va_arg(args, umm) :
+                            va_arg(args, int);
+                if (length == 'h') value = (short)value;
+                if (length == 'H') value = (signed char)value;
+                if (value != 0 || minDigits > 0) stringAppendS64(arena, s, value, minDigits);
+            } break;
+            case 'u':
+            case 'x':
+            case 'X': {
+                u64 value = length == 'L' ? va_arg(args, unsigned long long) :
+                            length == 'l' ? va_arg(args, unsigned long) :
+                            length == 'z' ? va_arg(args, umm) :
+                            va_arg(args, unsigned);
+                if (length == 'h') value = (unsigned short)value;
+                if (length == 'H') value = (unsigned char)value;
+                if (value != 0 || minDigits > 0) {
+                    stringAppendU64(arena, s, value, *fmt == 'u' ? 10 : 16, minDigits);
+                }
+                if (*fmt == 'X') {
+                    for (umm i = start; i < s->length; i++) {
+                        if (s->data[i] >= 'a' && s->data[i] <= 'f') s->data[i] -= 'a' - 'A';
+                    }
+                }
+            } break;
+            case 'p': {
+                stringAppend(arena, s, "0x", 2);
+                stringAppendU64(arena, s, (umm)va_arg(args, void*), 16);
+            } break;
+            case 'f': {
+                stringAppendF64(arena, s, va_arg(args, f64), hasPrecision ? precision : 6);
+            } break;
+            default: {
+                // NOTE(jan): args is past any * of this conversion, so those
+                // are written back in as numbers, and vsnprintf carries on
+                // from the conversion's own argument.
+                char head[32];
+                int headLength = snprintf(head, sizeof(head), "%%%s%s", left ? "-" : "", zeroFlag ? "0" : "");
+                if (width) headLength += snprintf(head + headLength, sizeof(head) - headLength, "%u", width);
+                if (hasPrecision) headLength += snprintf(head + headLength, sizeof(head) - headLength, ".%u", precision);
+
+                umm restLength = strlen(lengthStart);
+                char local[256];
+                char* rebuilt = local;
+                if (headLength + restLength + 1 > sizeof(local)) {
+                    rebuilt = (char*)malloc(headLength + restLength + 1);
+                }
+                memcpy(rebuilt, head, headLength);
+                memcpy(rebuilt + headLength, lengthStart, restLength + 1);
+
+                va_list measure;
+                va_copy(measure, args);
+                int needed = vsnprintf(nullptr, 0, rebuilt, measure);
+                va_end(measure);
+                if (needed > 0) {
+                    stringReserve(arena, s, s->length + needed + 1);
+                    vsnprintf(s->data + s->length, needed + 1, rebuilt, args);
+                    s->length += needed;
+                }
+                if (rebuilt != local) free(rebuilt);
+                return;
+            }
+        }
+        stringPadField(arena, s, start, width, left, zero && numeric);
+        fmt++;
+        run = fmt;
+    }
+    if (fmt > run) stringAppend(arena, s, run, fmt - run);
+}
+
+void
+stringFormat(MemoryArena* arena, String* s, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    stringFormatV(arena, s, fmt, args);
+    va_end(args);
+}
@@ -1,17 +1,14 @@
-#include <windows.h>
+#pragma once
 
-#ifdef WIN32
-    #define START_TIMER(X) \
-        LARGE_INTEGER start##X = {}; \
-        QueryPerformanceCounter(&start##X);
+#include "Clock.cpp"
 
-    #define END_TIMER(X) \
-        LARGE_INTEGER end##X = {}; \
-        QueryPerformanceCounter(&end##X); \
-        float delta##X = float(end##X.QuadPart - start##X.QuadPart) / \
-                         counterFrequency.QuadPart;
+// NOTE(jan): DELTA is in seconds, as it always was. DELTA_NS is the same
+// interval in nanoseconds, without the float's loss of precision.
+#define START_TIMER(X) \
+    u64 start##X = clockNow();
 
-    #define DELTA(X) delta##X
-#else
-    #error Timer.h not implemented for this platform.
-#endif
+#define END_TIMER(X) \
+    u64 delta##X = clockNow() - start##X;
+
+#define DELTA(X) ((float)clockSeconds(delta##X))
+#define DELTA_NS(X) delta##X
@@ -3,16 +3,20 @@
 
 #include <stdexcept>
 
+#include "Array.cpp"
+#include "HashMap.cpp"
+#include "Intern.cpp"
 #include "MathLib.cpp"
+#include "Memory.cpp"
 #include "Vulkan.h"
 
 using std::runtime_error;
 using std::string;
 
 const char**
-stringVectorToC(const vector<string>& v) {
+stringVectorToC(MemoryArena* arena, const vector<string>& v) {
     auto count = v.size();
-    auto strings = new const char*[count];
+    auto strings = memoryArenaAllocateArray(arena, const char*, count);
     for (unsigned i = 0; i < count; i++) {
         strings[i] = v[i].c_str();
     }
@@ -41,14 +45,19 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     const char *msg,
     void *userData
 ) {
+    // NOTE(jan): The text has object handles in it, so the same problem on
+    // another object would get a bucket of its own. The validation layers put
+    // the message's id in code instead. Others may leave it 0, and then all
+    // there is to go on is the text.
+    u64 key = code ? logHash(layerPrefix) ^ ((u64)(u32)code * 0x9e3779b97f4a7c15ull) : logHash(msg);
     if (flags == VK_DEBUG_REPORT_ERROR_BIT_EXT) {
-        LOG("ERROR", "[%s] %s", layerPrefix, msg);
+        LOG_KEYED(LOG_LEVEL_ERR, "ERROR", key, msg, "[%s] %s", layerPrefix, msg);
     } else if (flags == VK_DEBUG_REPORT_WARNING_BIT_EXT) {
-        LOG("WARNING", "[%s] %s", layerPrefix, msg);
+        LOG_KEYED(LOG_LEVEL_WARN, "WARNING", key, msg, "[%s] %s", layerPrefix, msg);
     } else if (flags == VK_DEBUG_REPORT_DEBUG_BIT_EXT) {
-        LOG("DEBUG", "[%s] %s", layerPrefix, msg);
+        LOG_KEYED(LOG_LEVEL_DEBUG, "DEBUG", key, msg, "[%s] %s", layerPrefix, msg);
     } else {
-        LOG("INFO", "[%s] %s", layerPrefix, msg);
+        LOG_KEYED(LOG_LEVEL_INFO, "INFO", key, msg, "[%s] %s", layerPrefix, msg);
     }
     return VK_FALSE;
 }
@@ -122,6 +131,7 @@ void createDebugCallback(Vulkan& vk) {
 }
 
 void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
+    MemoryArenaScope scratch(&scratchArena);
     uint32_t version;
 
     vkEnumerateInstanceVersion(&version);
@@ -129,7 +139,7 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
 
     vk.layers.push_back("VK_LAYER_KHRONOS_validation");
     uint32_t layerCount = 0;
-    vector<VkLayerProperties> layers;
+    auto layers = arrayCreate<VkLayerProperties>(&scratchArena);
     VKCHECK(
         vkEnumerateInstanceLayerProperties(
             &layerCount,
@@ -137,34 +147,30 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
         ),
         "could not fetch count of available layers"
     );
-    layers.resize(layerCount);
+    arrayResize(&layers, layerCount);
     VKCHECK(
         vkEnumerateInstanceLayerProperties( 
             &layerCount,
-            layers.data()
+            layers.data
         ),
         "could not fetch available layers"
     );
+    // NOTE(jan): Names are interned so that they can be looked up by pointer.
+    HashMap<const char*, bool> availableLayers;
+    hashMapInit(&availableLayers, &scratchArena, layerCount * 2);
     for (auto& layer: layers) {
         INFO("available layer: %s", layer.layerName);
+        hashMapPut(&availableLayers, intern(&internTable, layer.layerName), true);
     }
     for (auto& requestedLayer: vk.layers) {
-        const char* requestedString = requestedLayer.c_str();
-        bool found = false;
-        for (auto& availableLayer: layers) {
-            const char* availableString = availableLayer.layerName;
-            if (strcmp(requestedString, availableString) == 0) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
+        const char* requestedString = intern(&internTable, requestedLayer.c_str());
+        if (!hashMapGet(&availableLayers, requestedString)) {
             FATAL("layer %s is not available", requestedString);
         }
     }
 
     uint32_t extensionCount = 0;
-    vector<VkExtensionProperties> availableExtensions;
+    auto availableExtensions = arrayCreate<VkExtensionProperties>(&scratchArena);
     VKCHECK(
         vkEnumerateInstanceExtensionProperties(
             NULL,
@@ -172,12 +178,12 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
             NULL
         )
     )
-    availableExtensions.resize(extensionCount);
+    arrayResize(&availableExtensions, extensionCount);
     VKCHECK(
         vkEnumerateInstanceExtensionProperties(
             NULL,
             &extensionCount,
-            availableExtensions.data()
+            availableExtensions.data
         )
     )
 
@@ -188,28 +194,30 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
         VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
     );
 
+    HashMap<const char*, bool> requestedExtensions;
+    hashMapInit(&requestedExtensions, &scratchArena, vk.extensions.size() * 2);
+    for (auto& extension: vk.extensions) {
+        hashMapPut(&requestedExtensions, intern(&internTable, extension.c_str()), true);
+    }
     if (appExtensions != nullptr) {
         for (auto& appExtension: *appExtensions) {
-            for (auto& extension: vk.extensions) {
-                if (appExtension == extension) {
-                    goto OUTER;
-                }
+            const char* name = intern(&internTable, appExtension.c_str());
+            if (!hashMapGet(&requestedExtensions, name)) {
+                hashMapPut(&requestedExtensions, name, true);
+                vk.extensions.push_back(appExtension);
             }
-            vk.extensions.push_back(appExtension);
-            OUTER: ;
         }
     }
 
+    HashMap<const char*, bool> availableExtensionNames;
+    hashMapInit(&availableExtensionNames, &scratchArena, extensionCount * 2);
+    for (auto& extension: availableExtensions) {
+        hashMapPut(&availableExtensionNames, intern(&internTable, extension.extensionName), true);
+    }
     for (auto& requestedExtension: vk.extensions) {
-        bool found = false;
-        for (auto& availableExtension: availableExtensions) {
-            if (requestedExtension == availableExtension.extensionName) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            FATAL("extension %s not available", requestedExtension.c_str());
+        const char* name = intern(&internTable, requestedExtension.c_str());
+        if (!hashMapGet(&availableExtensionNames, name)) {
+            FATAL("extension %s not available", name);
         }
     }
 
@@ -222,11 +230,11 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
     createInfo.pApplicationInfo = &app;
 
     createInfo.enabledLayerCount = vk.layers.size();
-    auto enabledLayerNames = stringVectorToC(vk.layers);
+    auto enabledLayerNames = stringVectorToC(&scratchArena, vk.layers);
     createInfo.ppEnabledLayerNames = enabledLayerNames;
 
     createInfo.enabledExtensionCount = vk.extensions.size();
-    auto enabledExtensionNames = stringVectorToC(vk.extensions);
+    auto enabledExtensionNames = stringVectorToC(&scratchArena, vk.extensions);
     createInfo.ppEnabledExtensionNames = enabledExtensionNames;
     
     VkResult result = vkCreateInstance(&createInfo, nullptr, &vk.handle);
@@ -244,18 +252,18 @@ void createVKInstance(Vulkan& vk, vector<string>* appExtensions) {
     }
 
     createDebugCallback(vk);
-
-    delete[] enabledLayerNames;
-    delete[] enabledExtensionNames;
 }
 
 void pickGPU(Vulkan& vk) {
+    MemoryArenaScope scratch(&scratchArena);
+
     uint32_t gpuCount = 0;
     VKCHECK(vkEnumeratePhysicalDevices(vk.handle, &gpuCount, nullptr));
     INFO("%d physical device(s)", gpuCount);
 
-    vector<VkPhysicalDevice> gpus(gpuCount);
-    VKCHECK(vkEnumeratePhysicalDevices(vk.handle, &gpuCount, gpus.data()));
+    auto gpus = arrayCreate<VkPhysicalDevice>(&scratchArena);
+    arrayResize(&gpus, gpuCount);
+    VKCHECK(vkEnumeratePhysicalDevices(vk.handle, &gpuCount, gpus.data));
 
     for (auto gpu: gpus) {
         bool hasGraphicsQueue = false;
@@ -273,18 +281,17 @@ void pickGPU(Vulkan& vk) {
             &extensionCount,
             nullptr
         );
-        vector<VkExtensionProperties> extensions(extensionCount);
+        auto extensions = arrayCreate<VkExtensionProperties>(&scratchArena);
+        arrayResize(&extensions, extensionCount);
         vkEnumerateDeviceExtensionProperties(
             gpu,
             nullptr,
             &extensionCount,
-            extensions.data()
+            extensions.data
         );
         bool hasSwapChain = false;
-        string swapExtensionName(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-        for (auto extension: extensions) {
-            string name(extension.extensionName);
-            if (name == swapExtensionName) {
+        for (auto& extension: extensions) {
+            if (strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
                 hasSwapChain = true;
             }
         }
@@ -334,11 +341,12 @@ void pickGPU(Vulkan& vk) {
 
         uint32_t familyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
-        vector<VkQueueFamilyProperties> families(familyCount);
+        auto families = arrayCreate<VkQueueFamilyProperties>(&scratchArena);
+        arrayResize(&families, familyCount);
         vkGetPhysicalDeviceQueueFamilyProperties(
             gpu,
             &familyCount,
-            families.data()
+            families.data
         );
 
         for (uint32_t index = 0; index < familyCount; index++) {
@@ -394,16 +402,17 @@ void getFunctions(Vulkan& vk) {
 }
 
 void createDevice(Vulkan& vk) {
-    vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    MemoryArenaScope scratch(&scratchArena);
+    auto queueCreateInfos = arrayCreate<VkDeviceQueueCreateInfo>(&scratchArena);
+    float prio = 1.f;
 
     {
         VkDeviceQueueCreateInfo q = {};
         q.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         q.queueCount = 1;
         q.queueFamilyIndex = vk.queueFamily;
-        float prio = 1.f;
         q.pQueuePriorities = &prio;
-        queueCreateInfos.push_back(q);
+        arrayPush(&queueCreateInfos, q);
     }
 
 #ifdef VULKAN_COMPUTE
@@ -412,20 +421,20 @@ void createDevice(Vulkan& vk) {
         q.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         q.pNext = nullptr;
         q.flags = 0;
-        float prio = 1.f;
         q.pQueuePriorities = &prio;
         q.queueCount = 1;
         q.queueFamilyIndex = vk.computeQueueFamily;
-        queueCreateInfos.push_back(q);
+        arrayPush(&queueCreateInfos, q);
     }
 #endif
 
-    vector<const char*> extensions({ VK_KHR_SWAPCHAIN_EXTENSION_NAME });
+    auto extensions = arrayCreate<const char*>(&scratchArena);
+    arrayPush(&extensions, (const char*)VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
 #ifdef VULKAN_MESH_SHADER
 //TODO(jan): enabling this flag breaks RenderDoc
     if (vk.supportsMeshShaders) {
-        extensions.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
+        arrayPush(&extensions, (const char*)VK_NV_MESH_SHADER_EXTENSION_NAME);
     }
 
     VkPhysicalDeviceMeshShaderFeaturesNV meshFeatures = {};
@@ -448,11 +457,11 @@ void createDevice(Vulkan& vk) {
     }
 #endif
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(
-        queueCreateInfos.size()
+        queueCreateInfos.count
     );
-    createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.enabledExtensionCount = (uint32_t)extensions.size();
-    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.pQueueCreateInfos = queueCreateInfos.data;
+    createInfo.enabledExtensionCount = (uint32_t)extensions.count;
+    createInfo.ppEnabledExtensionNames = extensions.data;
 
     VKCHECK(vkCreateDevice(vk.gpu, &createInfo, nullptr, &vk.device));
     vkGetDeviceQueue(vk.device, vk.queueFamily, 0, &vk.queue);
@@ -467,8 +476,8 @@ void createRenderPass(
     bool prepass,
     VkRenderPass& renderPass
 ) {
-    vector<VkAttachmentDescription> attachments;
-    VkAttachmentDescription& color = attachments.emplace_back();
+    VkAttachmentDescription attachments[3] = {};
+    VkAttachmentDescription& color = attachments[0];
     color.format = vk.swap.format;
     color.samples = (VkSampleCountFlagBits)vk.sampleCountFlags;
     color.loadOp = clear
@@ -484,7 +493,7 @@ void createRenderPass(
         ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
         : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
-    VkAttachmentDescription& depth = attachments.emplace_back();
+    VkAttachmentDescription& depth = attachments[1];
     depth.format = VK_FORMAT_D32_SFLOAT;
     depth.samples = (VkSampleCountFlagBits)vk.sampleCountFlags;
     depth.loadOp = clear
@@ -498,7 +507,7 @@ void createRenderPass(
         : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkAttachmentDescription& resolve = attachments.emplace_back();
+    VkAttachmentDescription& resolve = attachments[2];
     resolve.format = vk.swap.format;
     resolve.samples = VK_SAMPLE_COUNT_1_BIT;
     resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -508,12 +517,9 @@ void createRenderPass(
     resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     resolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
-// TODO(jan): can this vector be removed
-    vector<VkAttachmentReference> colorReferences;
     VkAttachmentReference colorReference = {};
     colorReference.attachment = 0;
     colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    colorReferences.push_back(colorReference);
 
     VkAttachmentReference depthReference = {};
     depthReference.attachment = 1;
@@ -523,14 +529,12 @@ void createRenderPass(
     resolveReference.attachment = 2;
     resolveReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-    vector<VkSubpassDescription> subpasses;
     VkSubpassDescription subpass = {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = (uint32_t)colorReferences.size();
-    subpass.pColorAttachments = colorReferences.data();
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
     subpass.pDepthStencilAttachment = &depthReference;
     subpass.pResolveAttachments = &resolveReference;
-    subpasses.push_back(subpass);
 
     VkSubpassDependency dependency = {};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -542,10 +546,10 @@ void createRenderPass(
 
     VkRenderPassCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    createInfo.attachmentCount = (uint32_t)attachments.size();
-    createInfo.pAttachments = attachments.data();
-    createInfo.subpassCount = (uint32_t)subpasses.size();
-    createInfo.pSubpasses = subpasses.data();
+    createInfo.attachmentCount = 3;
+    createInfo.pAttachments = attachments;
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
     createInfo.dependencyCount = 1;
     createInfo.pDependencies = &dependency;
 
@@ -563,7 +567,20 @@ void initVK(Vulkan& vk) {
 #endif
     initVKSwapChain(vk);
     vk.memories = getMemories(vk.gpu);
-    createUniformBuffer(vk.device, vk.memories, vk.queueFamily, 1024, vk.uniforms);
+    {
+        VkPhysicalDeviceProperties props = {};
+        vkGetPhysicalDeviceProperties(vk.gpu, &props);
+        VkDeviceSize alignment = props.limits.minUniformBufferOffsetAlignment;
+        if (alignment == 0) alignment = 1;
+        vk.uniformsStride = (VULKAN_UNIFORMS_SIZE + alignment - 1) / alignment * alignment;
+        createUniformBuffer(
+            vk.device,
+            vk.memories,
+            vk.queueFamily,
+            (uint32_t)(vk.uniformsStride * vk.swap.images.size()),
+            vk.uniforms
+        );
+    }
     createRenderPass(vk, true, false, vk.renderPass);
     createRenderPass(vk, false, false, vk.renderPassNoClear);
     createVulkanColorBuffer(
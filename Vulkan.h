@@ -6,6 +6,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include "Memory.cpp"
 #include "SPIRV-Reflect/spirv_reflect.h"
 #include "vulkan/vulkan_core.h"
 
@@ -42,6 +43,18 @@ struct VulkanSwapChain {
     vector<VulkanImage> images;
     vector<VkFramebuffer> framebuffers;
     VkSurfaceKHR surface;
+    // NOTE(jan): Fence of the frame that last rendered to each image.
+    vector<VkFence> imagesInFlight;
+};
+
+const uint32_t VULKAN_FRAMES_IN_FLIGHT = 2;
+const uint32_t VULKAN_UNIFORMS_SIZE = 1024;
+
+// NOTE(jan): Anything allocated from a frame's arena stays valid until the
+// GPU has finished that frame, which is when beginFrame resets it.
+struct VulkanFrame {
+    MemoryArena arena;
+    VkFence inFlight;
     VkSemaphore imageReady;
     VkSemaphore cmdBufferDone;
 };
@@ -63,10 +76,19 @@ struct Vulkan {
     VkRenderPass renderPass;
     VkRenderPass renderPassNoClear;
     VulkanSwapChain swap;
+    VulkanFrame frames[VULKAN_FRAMES_IN_FLIGHT];
+    uint32_t frameIndex;
 
     VulkanImage color;
     VulkanImage depth;
+    // NOTE(jan): One slice of uniformsStride bytes per swap chain image,
+    // since command buffers are recorded once per image. updateUniforms only
+    // copies into pendingUniforms; present writes them into the slice of the
+    // image it acquired, once that image's last frame is done with it.
     VulkanBuffer uniforms;
+    VkDeviceSize uniformsStride;
+    uint8_t pendingUniforms[VULKAN_UNIFORMS_SIZE];
+    uint32_t pendingUniformsLength;
 
     VkCommandPool cmdPool;
     VkCommandPool cmdPoolTransient;
@@ -111,6 +133,10 @@ struct VulkanPipeline {
     VulkanShader fragmentShader;
     VkDescriptorSetLayout descriptorLayout;
     VkDescriptorPool descriptorPool;
+    // NOTE(jan): One set per swap chain image, so that each image's command
+    // buffers can bind their own slice of vk.uniforms. descriptorSet is the
+    // first of them, for pipelines that do not read uniforms.
+    vector<VkDescriptorSet> descriptorSets;
     VkDescriptorSet descriptorSet;
     VkVertexInputBindingDescription inputBinding;
     vector<VkVertexInputAttributeDescription> inputAttributes;
@@ -131,6 +157,7 @@ void createFramebuffers(Vulkan&);
 void createVKInstance(Vulkan&, vector<string>* = nullptr);
 void initVK(Vulkan&);
 void initVKSwapChain(Vulkan&);
+void destroyFrames(Vulkan&);
 
 // Memory Types & Allocation
 VkPhysicalDeviceMemoryProperties getMemories(VkPhysicalDevice gpu);
@@ -146,6 +173,8 @@ void unMapMemory(VkDevice device, VkDeviceMemory memory);
 
 // Synchronization
 VkSemaphore createSemaphore(VkDevice device);
+VkFence createFence(VkDevice device, bool signaled);
+void waitForFrames(Vulkan& vk);
 
 // Render Pass
 void createRenderPass(
@@ -204,11 +233,22 @@ void updateBuffer(
     void* data,
     size_t length
 );
+// NOTE(jan): Frames overlap, so a buffer may still be read by a frame in
+// flight. updateSharedBuffer waits for all of them before it writes; it is
+// meant for data that changes now and then. Uniforms that change every frame
+// go through updateUniforms, which does not wait at all.
+void updateSharedBuffer(
+    Vulkan& vk,
+    VulkanBuffer& buffer,
+    void* data,
+    size_t length
+);
 void updateUniforms(
     Vulkan& vk,
     void* data,
     size_t length
 );
+void writeImageUniforms(Vulkan& vk, uint32_t imageIndex);
 void uploadIndexBuffer(
     VkDevice device,
     VkPhysicalDeviceMemoryProperties& memories,
@@ -341,6 +381,9 @@ void initVKPipeline(
 );
 
 // Descriptors
+// NOTE(jan): Descriptor sets may not be updated while a frame in flight uses
+// them. Only call these at load time, or after waitForFrames, and write each
+// of a pipeline's descriptorSets.
 void updateCombinedImageSampler(
     VkDevice device,
     VkDescriptorSet descriptorSet,
@@ -360,6 +403,13 @@ void updateUniformBuffer(
     uint32_t binding,
     VkBuffer buffer
 );
+// NOTE(jan): Points binding of each of the pipeline's descriptor sets at the
+// matching image's slice of vk.uniforms.
+void updateImageUniforms(
+    Vulkan& vk,
+    VulkanPipeline& pipeline,
+    uint32_t binding
+);
 void updateUniformTexelBuffer(
     VkDevice device,
     VkDescriptorSet descriptorSet,
@@ -387,6 +437,9 @@ void uploadMesh(
 );
 
 // Present
+VulkanFrame& beginFrame(
+    Vulkan& vk
+);
 void present(
     Vulkan& vk,
     VkCommandBuffer* cmdss,
@@ -208,12 +208,34 @@ void updateBuffer(
     unMapMemory(vk.device, buffer.memory);
 }
 
+void updateSharedBuffer(
+    Vulkan& vk,
+    VulkanBuffer& buffer,
+    void* data,
+    size_t length
+) {
+    waitForFrames(vk);
+    updateBuffer(vk, buffer, data, length);
+}
+
 void updateUniforms(
     Vulkan& vk,
     void* data,
     size_t length
 ) {
-    updateBuffer(vk, vk.uniforms, data, length);
+    if (length > VULKAN_UNIFORMS_SIZE) {
+        FATAL("%zu bytes of uniforms, at most %u fit", length, VULKAN_UNIFORMS_SIZE);
+    }
+    memcpy(vk.pendingUniforms, data, length);
+    vk.pendingUniformsLength = (uint32_t)length;
+}
+
+// NOTE(jan): Called by present once nothing reads the image's slice.
+void writeImageUniforms(Vulkan& vk, uint32_t imageIndex) {
+    if (vk.pendingUniformsLength == 0) return;
+    auto dst = (uint8_t*)mapMemory(vk.device, vk.uniforms.memory);
+        memcpy(dst + imageIndex * vk.uniformsStride, vk.pendingUniforms, vk.pendingUniformsLength);
+    unMapMemory(vk.device, vk.uniforms.memory);
 }
 
 void uploadStorageBuffer(
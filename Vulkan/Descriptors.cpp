@@ -1,3 +1,4 @@
+#include "Array.cpp"
 #include "Vulkan.h"
 
 void updateUniformBuffer(
@@ -22,6 +23,29 @@ void updateUniformBuffer(
     vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
 }
 
+void updateImageUniforms(
+    Vulkan& vk,
+    VulkanPipeline& pipeline,
+    uint32_t binding
+) {
+    for (uint32_t i = 0; i < pipeline.descriptorSets.size(); i++) {
+        VkDescriptorBufferInfo info;
+        info.buffer = vk.uniforms.handle;
+        info.offset = i * vk.uniformsStride;
+        info.range = vk.uniformsStride;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.dstBinding = binding;
+        write.dstSet = pipeline.descriptorSets[i];
+        write.pBufferInfo = &info;
+
+        vkUpdateDescriptorSets(vk.device, 1, &write, 0, nullptr);
+    }
+}
+
 void updateCombinedImageSampler(
     VkDevice device,
     VkDescriptorSet descriptorSet,
@@ -29,7 +53,9 @@ void updateCombinedImageSampler(
     VulkanSampler* samplers,
     uint32_t count
 ) {
-    vector<VkDescriptorImageInfo> infos(count);
+    MemoryArenaScope scratch(&scratchArena);
+    auto infos = arrayCreate<VkDescriptorImageInfo>(&scratchArena, count);
+    arrayResize(&infos, count);
     for (int i = 0; i < count; i++) {
         auto& info = infos[i];
         auto& sampler = samplers[i];
@@ -40,11 +66,11 @@ void updateCombinedImageSampler(
 
     VkWriteDescriptorSet write = {};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write.descriptorCount = (uint32_t)infos.size();
+    write.descriptorCount = (uint32_t)infos.count;
     write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     write.dstSet = descriptorSet;
     write.dstBinding = binding;
-    write.pImageInfo = infos.data();
+    write.pImageInfo = infos.data;
 
     vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
 }
@@ -6,34 +6,38 @@
 
 #include <cassert>
 #include <io.h>
-#include <map>
 
+#include "Array.cpp"
 #include "FileSystem.cpp"
+#include "HashMap.cpp"
+#include "Intern.cpp"
+#include "String.cpp"
 #include "Vulkan.h"
 
-using std::map;
-
 void createDescriptorLayout(
     Vulkan& vk,
     vector<VulkanShader>& shaders,
     VulkanPipeline& pipeline
 ) {
-    vector<VkDescriptorSetLayoutBinding> bindings;
-    vector<VkDescriptorBindingFlags> flags;
+    MemoryArenaScope scratch(&scratchArena);
+    auto bindings = arrayCreate<VkDescriptorSetLayoutBinding>(&scratchArena);
+    auto flags = arrayCreate<VkDescriptorBindingFlags>(&scratchArena);
 
-    map<uint32_t, VkDescriptorSetLayoutBinding*> bindingDescMap;
+    // NOTE(jan): Maps binding numbers to indices into bindings.
+    HashMap<uint32_t, uint32_t> bindingDescMap;
+    hashMapInit(&bindingDescMap, &scratchArena);
 
     for (auto& shader: shaders) {
         for (auto& set: shader.sets) {
             for (uint32_t i = set->set; i < set->binding_count; i++) {
                 auto& spirv = *(set->bindings[i]);
 
-                auto existingDesc = bindingDescMap[spirv.binding];
-                if (existingDesc) {
-                    existingDesc->stageFlags |= shader.reflect.shader_stage;
+                auto existingIndex = hashMapGet(&bindingDescMap, spirv.binding);
+                if (existingIndex) {
+                    bindings[*existingIndex].stageFlags |= shader.reflect.shader_stage;
                 } else {
-                    auto& desc = bindings.emplace_back();
-                    bindingDescMap[spirv.binding] = &desc;
+                    hashMapPut(&bindingDescMap, spirv.binding, (uint32_t)bindings.count);
+                    auto& desc = arrayPush(&bindings);
                     desc.binding = spirv.binding;
                     desc.descriptorCount = spirv.count;
                     desc.descriptorType = (VkDescriptorType)spirv.descriptor_type;
@@ -41,7 +45,7 @@ void createDescriptorLayout(
 
 // TODO(jan): this flag only applies to combined image samplers, does it break
 // anything to enable it for everything?
-                    auto& flag = flags.emplace_back();
+                    auto& flag = arrayPush(&flags);
                     flag = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
                 }
             }
@@ -50,14 +54,14 @@ void createDescriptorLayout(
 
     VkDescriptorSetLayoutBindingFlagsCreateInfo flagCI = {};
     flagCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-    flagCI.bindingCount = (uint32_t)bindings.size();
-    flagCI.pBindingFlags = flags.data();
+    flagCI.bindingCount = (uint32_t)bindings.count;
+    flagCI.pBindingFlags = flags.data;
 
     VkDescriptorSetLayoutCreateInfo descriptors = {};
     descriptors.pNext = (void*)(&flagCI);
     descriptors.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptors.bindingCount = (uint32_t)bindings.size();
-    descriptors.pBindings = bindings.data();
+    descriptors.bindingCount = (uint32_t)bindings.count;
+    descriptors.pBindings = bindings.data;
     
     VKCHECK(vkCreateDescriptorSetLayout(
         vk.device,
@@ -72,7 +76,8 @@ void createDescriptorPool(
     vector<VulkanShader>& shaders,
     VulkanPipeline& pipeline
 ) {
-    vector<VkDescriptorPoolSize> sizes;
+    MemoryArenaScope scratch(&scratchArena);
+    auto sizes = arrayCreate<VkDescriptorPoolSize>(&scratchArena);
 
     for (auto& shader: shaders) {
         for (auto& set: shader.sets) {
@@ -89,7 +94,7 @@ void createDescriptorPool(
                 }
 
                 if (size == nullptr) {
-                    auto& size = sizes.emplace_back();
+                    auto& size = arrayPush(&sizes);
                     size.descriptorCount = spirv.count;
                     size.type = type;
                 } else {
@@ -99,14 +104,20 @@ void createDescriptorPool(
         }
     }
 
-    if (sizes.size() == 0) {
+    // NOTE(jan): Room for one set per swap chain image.
+    uint32_t setCount = (uint32_t)vk.swap.images.size();
+    for (auto& size: sizes) {
+        size.descriptorCount *= setCount;
+    }
+
+    if (sizes.count == 0) {
         pipeline.descriptorPool = VK_NULL_HANDLE;
     } else {
         VkDescriptorPoolCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        createInfo.maxSets = 1;
-        createInfo.poolSizeCount = sizes.size();
-        createInfo.pPoolSizes = sizes.data();
+        createInfo.maxSets = setCount;
+        createInfo.poolSizeCount = sizes.count;
+        createInfo.pPoolSizes = sizes.data;
 
         VKCHECK(vkCreateDescriptorPool(
             vk.device,
@@ -119,18 +130,28 @@ void createDescriptorPool(
 
 void allocateDescriptorSet(Vulkan& vk, VulkanPipeline& pipeline) {
     if (pipeline.descriptorPool == VK_NULL_HANDLE) {
+        pipeline.descriptorSets.clear();
         pipeline.descriptorSet = VK_NULL_HANDLE;
     } else {
+        MemoryArenaScope scratch(&scratchArena);
+        uint32_t setCount = (uint32_t)vk.swap.images.size();
+        auto layouts = arrayCreate<VkDescriptorSetLayout>(&scratchArena, setCount);
+        for (uint32_t i = 0; i < setCount; i++) {
+            arrayPush(&layouts, pipeline.descriptorLayout);
+        }
+        pipeline.descriptorSets.resize(setCount);
+
         VkDescriptorSetAllocateInfo allocateInfo = {};
         allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocateInfo.descriptorPool = pipeline.descriptorPool;
-        allocateInfo.descriptorSetCount = 1;
-        allocateInfo.pSetLayouts = &pipeline.descriptorLayout;
+        allocateInfo.descriptorSetCount = setCount;
+        allocateInfo.pSetLayouts = layouts.data;
         VKCHECK(vkAllocateDescriptorSets(
             vk.device,
             &allocateInfo,
-            &pipeline.descriptorSet
+            pipeline.descriptorSets.data()
         ));
+        pipeline.descriptorSet = pipeline.descriptorSets[0];
     }
 }
 
@@ -167,23 +188,24 @@ void createShaderModule(
     ));
 }
 
-void createShaderModule(Vulkan& vk, const string& path, VulkanShader& shader) {
-    auto accessResult = _access_s(path.c_str(), 4);
+void createShaderModule(Vulkan& vk, const char* path, VulkanShader& shader) {
+    auto accessResult = _access_s(path, 4);
     if (accessResult == EACCES) {
-        FATAL("file '%s': access denied", path.c_str());
+        FATAL("file '%s': access denied", path);
     } else if (accessResult == ENOENT) {
-        FATAL("file '%s': file not found", path.c_str());
+        FATAL("file '%s': file not found", path);
     }
     auto code = readFile(path);
     createShaderModule(vk, code, shader);
 }
 
 void createPipelineLayout(Vulkan& vk, vector<VulkanShader>& shaders, VulkanPipeline& pipeline) {
-    vector<VkPushConstantRange> pushConstantRanges;
+    MemoryArenaScope scratch(&scratchArena);
+    auto pushConstantRanges = arrayCreate<VkPushConstantRange>(&scratchArena);
     for (auto& shader: shaders) {
         for (int i = 0; i < shader.reflect.push_constant_block_count; i++) {
             auto& block = shader.reflect.push_constant_blocks[i];
-            auto& range = pushConstantRanges.emplace_back();
+            auto& range = arrayPush(&pushConstantRanges);
             range.stageFlags = shader.reflect.shader_stage;
             range.offset = block.offset;
             range.size = block.padded_size;
@@ -194,8 +216,8 @@ void createPipelineLayout(Vulkan& vk, vector<VulkanShader>& shaders, VulkanPipel
     createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     createInfo.setLayoutCount = 1;
     createInfo.pSetLayouts = &pipeline.descriptorLayout;
-    createInfo.pushConstantRangeCount = pushConstantRanges.size();
-    createInfo.pPushConstantRanges = pushConstantRanges.data();
+    createInfo.pushConstantRangeCount = pushConstantRanges.count;
+    createInfo.pPushConstantRanges = pushConstantRanges.data;
     VKCHECK(vkCreatePipelineLayout(
         vk.device,
         &createInfo,
@@ -215,22 +237,31 @@ void describeInputAttributes(
     VulkanPipeline& pipeline,
     VulkanShader& shader
 ) {
+    MemoryArenaScope scratch(&scratchArena);
+
     uint32_t count = 0;
     spvReflectEnumerateInputVariables(&shader.reflect, &count, nullptr);
-    vector<SpvReflectInterfaceVariable*> inputs(count);
-    spvReflectEnumerateInputVariables(&shader.reflect, &count, inputs.data());
+    auto inputs = arrayCreate<SpvReflectInterfaceVariable*>(&scratchArena);
+    arrayResize(&inputs, count);
+    spvReflectEnumerateInputVariables(&shader.reflect, &count, inputs.data);
 
     // NOTE(jan): input attributes may be enumerated out of order, so
     // they need to be sorted when calculating the offset
     std::sort(inputs.begin(), inputs.end(), compareInputAttributes);
 
+    static const char* inUV = intern(&internTable, "inUV");
+    static const char* inNormal = intern(&internTable, "inNormal");
+    static const char* inColor = intern(&internTable, "inColor");
+
     pipeline.inputBinding.stride = 0;
     for (auto input: inputs) {
-        if (strcmp("inUV", input->name) == 0) {
+        // NOTE(jan): Only the names above matter, so don't add the rest.
+        const char* name = input->name ? internFind(&internTable, input->name) : nullptr;
+        if (name == inUV) {
             pipeline.needsTexCoords = true;
-        } else if (strcmp("inNormal", input->name) == 0) {
+        } else if (name == inNormal) {
             pipeline.needsNormals = true;
-        } else if (strcmp("inColor", input->name) == 0) {
+        } else if (name == inColor) {
             pipeline.needsColor = true;
         }
 
@@ -256,14 +287,15 @@ void createPipeline(
     VulkanPipeline& pipeline,
     VkRenderPass* renderPass = nullptr
 ) {
+    MemoryArenaScope scratch(&scratchArena);
+
     pipeline.options = info;
 
     bool isMeshPipeline = false;
 
-    vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    auto shaderStages = arrayCreate<VkPipelineShaderStageCreateInfo>(&scratchArena);
     for (auto& shader: shaders) {
-        auto& shaderStage = shaderStages.emplace_back();
-        shaderStage = {};
+        auto& shaderStage = arrayPush(&shaderStages);
         shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStage.stage = (VkShaderStageFlagBits)shader.reflect.shader_stage;
         shaderStage.module = shader.module;
@@ -432,8 +464,8 @@ void createPipeline(
 
     VkGraphicsPipelineCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    createInfo.stageCount = (uint32_t)shaderStages.size();
-    createInfo.pStages = shaderStages.data();
+    createInfo.stageCount = (uint32_t)shaderStages.count;
+    createInfo.pStages = shaderStages.data;
     createInfo.pVertexInputState = &vertexInput;
     createInfo.pInputAssemblyState = &assembly;
     createInfo.pViewportState = &viewportState;
@@ -493,11 +525,13 @@ void initVKPipelineCompute(
     char* name,
     VulkanPipeline& pipeline
 ) {
+    MemoryArenaScope scratch(&scratchArena);
+
     vector<VulkanShader> shaders(1);
     auto& shader = shaders[0];
-    char computeFile[255];
-    sprintf_s(computeFile, "shaders/%s.comp.spv", name);
-    createShaderModule(vk, computeFile, shader);
+    String computeFile = {};
+    stringFormat(&scratchArena, &computeFile, "shaders/%s.comp.spv", name);
+    createShaderModule(vk, computeFile.data, shader);
 
     createDescriptorLayout(vk, shaders, pipeline);
     createDescriptorPool(vk, shaders, pipeline);
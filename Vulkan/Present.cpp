@@ -4,13 +4,42 @@
 
 #undef max
 
+// NOTE(jan): Waits until the GPU is done with the frame that last used this
+// slot, then hands back its arena empty. Call once per frame, before present.
+VulkanFrame& beginFrame(Vulkan& vk) {
+    VulkanFrame& frame = vk.frames[vk.frameIndex];
+    VKCHECK(vkWaitForFences(
+        vk.device,
+        1,
+        &frame.inFlight,
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max()
+    ));
+    memoryArenaReset(&frame.arena);
+    return frame;
+}
+
+// NOTE(jan): Submits the current frame without waiting for the device, so
+// the next frame's CPU work overlaps with this one. Resources shared between
+// frames must not be written while it is in flight, see updateSharedBuffer.
 void present(Vulkan& vk, VkCommandBuffer* cmds, uint32_t cmdCount) {
+    VulkanFrame& frame = vk.frames[vk.frameIndex];
+
+    // NOTE(jan): Already signaled if beginFrame was called for this frame.
+    VKCHECK(vkWaitForFences(
+        vk.device,
+        1,
+        &frame.inFlight,
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max()
+    ));
+
     uint32_t imageIndex = 0;
     auto result = vkAcquireNextImageKHR(
         vk.device,
         vk.swap.handle,
         std::numeric_limits<uint64_t>::max(),
-        vk.swap.imageReady,
+        frame.imageReady,
         VK_NULL_HANDLE,
         &imageIndex
     );
@@ -22,28 +51,45 @@ void present(Vulkan& vk, VkCommandBuffer* cmds, uint32_t cmdCount) {
         throw std::runtime_error("could not acquire next image");
     }
 
+    // NOTE(jan): The image's command buffers and its slice of the uniforms
+    // are reused, so wait for the frame that last submitted them if it is a
+    // different one.
+    VkFence& imageFence = vk.swap.imagesInFlight[imageIndex];
+    if (imageFence != VK_NULL_HANDLE && imageFence != frame.inFlight) {
+        VKCHECK(vkWaitForFences(
+            vk.device,
+            1,
+            &imageFence,
+            VK_TRUE,
+            std::numeric_limits<uint64_t>::max()
+        ));
+    }
+    imageFence = frame.inFlight;
+    writeImageUniforms(vk, imageIndex);
+
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = cmdCount;
     submitInfo.pCommandBuffers = cmds + (imageIndex * cmdCount);
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &vk.swap.imageReady;
+    submitInfo.pWaitSemaphores = &frame.imageReady;
     VkPipelineStageFlags waitStages[] = {
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
     };
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &vk.swap.cmdBufferDone;
-    vkQueueSubmit(vk.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    submitInfo.pSignalSemaphores = &frame.cmdBufferDone;
+    VKCHECK(vkResetFences(vk.device, 1, &frame.inFlight));
+    VKCHECK(vkQueueSubmit(vk.queue, 1, &submitInfo, frame.inFlight));
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &vk.swap.handle;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &vk.swap.cmdBufferDone;
+    presentInfo.pWaitSemaphores = &frame.cmdBufferDone;
     presentInfo.pImageIndices = &imageIndex;
     VKCHECK(vkQueuePresentKHR(vk.queue, &presentInfo));
 
-    vkDeviceWaitIdle(vk.device);
+    vk.frameIndex = (vk.frameIndex + 1) % VULKAN_FRAMES_IN_FLIGHT;
 }
@@ -1,7 +1,10 @@
+#include "Array.cpp"
 #include "Vulkan.h"
 #include "vulkan/vulkan_core.h"
 
 void findSwapFormats(Vulkan& vk) {
+    MemoryArenaScope scratch(&scratchArena);
+
     VKCHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
         vk.gpu,
         vk.swap.surface,
@@ -25,12 +28,13 @@ void findSwapFormats(Vulkan& vk) {
         &surfaceFormatCount,
         nullptr
     );
-    vector<VkSurfaceFormatKHR> surfaceFormats(surfaceFormatCount);
+    auto surfaceFormats = arrayCreate<VkSurfaceFormatKHR>(&scratchArena);
+    arrayResize(&surfaceFormats, surfaceFormatCount);
     vkGetPhysicalDeviceSurfaceFormatsKHR(
         vk.gpu,
         vk.swap.surface,
         &surfaceFormatCount,
-        surfaceFormats.data()
+        surfaceFormats.data
     );
 
     vk.swap.format = surfaceFormats[0].format;
@@ -51,12 +55,13 @@ void findSwapFormats(Vulkan& vk) {
         &presentModeCount,
         nullptr
     );
-    vector<VkPresentModeKHR> presentModes(presentModeCount);
+    auto presentModes = arrayCreate<VkPresentModeKHR>(&scratchArena);
+    arrayResize(&presentModes, presentModeCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(
         vk.gpu,
         vk.swap.surface,
         &presentModeCount,
-        presentModes.data()
+        presentModes.data
     );
     vk.swap.presentMode = VK_PRESENT_MODE_FIFO_KHR;
     for (auto availablePresentMode: presentModes) {
@@ -90,17 +95,20 @@ void createSwapChain(Vulkan& vk) {
 }
 
 void getImages(Vulkan& vk) {
+    MemoryArenaScope scratch(&scratchArena);
+
     uint32_t count = 0;
     vkGetSwapchainImagesKHR(vk.device, vk.swap.handle, &count, nullptr);
-    vector<VkImage> handles(count);
+    auto handles = arrayCreate<VkImage>(&scratchArena);
+    arrayResize(&handles, count);
     vk.swap.images.resize(count);
     VKCHECK(vkGetSwapchainImagesKHR(
         vk.device,
         vk.swap.handle,
         &count,
-        handles.data()
+        handles.data
     ));
-    for (int i = 0; i < handles.size(); i++) {
+    for (int i = 0; i < handles.count; i++) {
         vk.swap.images[i].handle = handles[i];
     }
 }
@@ -138,9 +146,31 @@ void createFramebuffers(Vulkan& vk) {
     }
 }
 
-void createSemaphores(Vulkan& vk) {
-    vk.swap.imageReady = createSemaphore(vk.device);
-    vk.swap.cmdBufferDone = createSemaphore(vk.device);
+void createFrames(Vulkan& vk) {
+    for (auto& frame: vk.frames) {
+        frame.imageReady = createSemaphore(vk.device);
+        frame.cmdBufferDone = createSemaphore(vk.device);
+        // NOTE(jan): Signaled, so that the first wait on each frame returns.
+        frame.inFlight = createFence(vk.device, true);
+    }
+    vk.frameIndex = 0;
+    vk.swap.imagesInFlight.assign(vk.swap.images.size(), VK_NULL_HANDLE);
+}
+
+// NOTE(jan): Waits for every frame in flight, then destroys what createFrames
+// made for them, and the uniforms initVK made for the images.
+void destroyFrames(Vulkan& vk) {
+    waitForFrames(vk);
+    for (auto& frame: vk.frames) {
+        vkDestroySemaphore(vk.device, frame.imageReady, nullptr);
+        vkDestroySemaphore(vk.device, frame.cmdBufferDone, nullptr);
+        vkDestroyFence(vk.device, frame.inFlight, nullptr);
+        memoryArenaClear(&frame.arena);
+        frame = {};
+    }
+    destroyBuffer(vk, vk.uniforms);
+    vk.uniforms = {};
+    vk.swap.imagesInFlight.clear();
 }
 
 void initVKSwapChain(Vulkan& vk) {
@@ -148,5 +178,5 @@ void initVKSwapChain(Vulkan& vk) {
     createSwapChain(vk);
     getImages(vk);
     createViews(vk);
-    createSemaphores(vk);
+    createFrames(vk);
 }
@@ -14,3 +14,36 @@ VkSemaphore createSemaphore(VkDevice device) {
 
     return result;
 }
+
+VkFence createFence(VkDevice device, bool signaled) {
+    VkFence result;
+
+    VkFenceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (signaled) {
+        createInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    }
+    VKCHECK(vkCreateFence(
+        device,
+        &createInfo,
+        nullptr,
+        &result
+    ));
+
+    return result;
+}
+
+// NOTE(jan): Blocks until the GPU has finished every frame in flight.
+void waitForFrames(Vulkan& vk) {
+    VkFence fences[VULKAN_FRAMES_IN_FLIGHT];
+    for (uint32_t i = 0; i < VULKAN_FRAMES_IN_FLIGHT; i++) {
+        fences[i] = vk.frames[i].inFlight;
+    }
+    VKCHECK(vkWaitForFences(
+        vk.device,
+        VULKAN_FRAMES_IN_FLIGHT,
+        fences,
+        VK_TRUE,
+        UINT64_MAX
+    ));
+}
@@ -0,0 +1,89 @@
+// NOTE(jan): Multi-threaded small allocations from malloc, a MemoryArena
+// behind a mutex, a SharedMemoryArena and per-thread child arenas.
+//
+//   g++ -std=c++17 -O2 -pthread bench/ArenaThreads.cpp -o ArenaThreads
+//   cl /std:c++17 /O2 /EHsc bench\ArenaThreads.cpp
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Memory.cpp"
+
+const umm ALLOCATIONS_PER_THREAD = 1000000;
+const umm ALLOCATION_SIZE = 48;
+
+template<typename F>
+f64
+benchThreads(u32 threadCount, F work) {
+    std::vector<std::thread> threads;
+    u64 start = clockNow();
+    for (u32 t = 0; t < threadCount; t++) {
+        threads.emplace_back(work, t);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    u64 elapsed = clockNow() - start;
+    return (f64)elapsed / (threadCount * ALLOCATIONS_PER_THREAD);
+}
+
+// NOTE(jan): Keeps the compiler from dropping the allocations.
+inline void
+benchTouch(void* p) {
+    *(volatile u8*)p = 1;
+}
+
+int
+main() {
+    u32 maxThreads = std::thread::hardware_concurrency();
+    if (maxThreads < 8) maxThreads = 8;
+
+    printf("%8s %12s %12s %12s %12s\n", "threads", "malloc", "locked", "shared", "child");
+    for (u32 threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        std::vector<std::vector<void*>> pointers(threadCount);
+        for (auto& p : pointers) p.resize(ALLOCATIONS_PER_THREAD);
+
+        f64 mallocNs = benchThreads(threadCount, [&](u32 t) {
+            for (umm i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+                pointers[t][i] = malloc(ALLOCATION_SIZE);
+                benchTouch(pointers[t][i]);
+            }
+        });
+        for (auto& p : pointers) for (void* q : p) free(q);
+
+        MemoryArena lockedArena = {};
+        std::mutex lock;
+        f64 lockedNs = benchThreads(threadCount, [&](u32) {
+            for (umm i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+                void* p;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    p = memoryArenaAllocateAligned(&lockedArena, ALLOCATION_SIZE, 16);
+                }
+                benchTouch(p);
+            }
+        });
+        memoryArenaClear(&lockedArena);
+
+        SharedMemoryArena sharedArena{};
+        f64 sharedNs = benchThreads(threadCount, [&](u32) {
+            for (umm i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+                benchTouch(sharedMemoryArenaAllocate(&sharedArena, ALLOCATION_SIZE, 16));
+            }
+        });
+        sharedMemoryArenaClear(&sharedArena);
+
+        f64 childNs = benchThreads(threadCount, [&](u32) {
+            MemoryArena child;
+            memoryArenaInitChild(&child, &sharedArena);
+            for (umm i = 0; i < ALLOCATIONS_PER_THREAD; i++) {
+                benchTouch(memoryArenaAllocateAligned(&child, ALLOCATION_SIZE, 16));
+            }
+        });
+        sharedMemoryArenaClear(&sharedArena);
+
+        printf("%8u %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n",
+               threadCount, mallocNs, lockedNs, sharedNs, childNs);
+    }
+}
@@ -0,0 +1,92 @@
+// NOTE(jan): Filters a full scrollback of INFO lines, with a few rare
+// warnings from another file among them, by level, by file and by text, with
+// consoleSearch and with a scan of every line. The line count can be passed
+// as the first argument.
+//
+//   g++ -std=c++17 -O2 -pthread bench/ConsoleSearch.cpp -o ConsoleSearch
+//   cl /std:c++17 /O2 /EHsc bench\ConsoleSearch.cpp
+
+// NOTE(jan): Memory.cpp brings in Logging.cpp and the arena it allocates from.
+#include "../Memory.cpp"
+
+const u32 RARE_LINES = 10;
+const u32 MAX_RESULTS = 64;
+const u32 REPEATS = 20;
+
+// NOTE(jan): What consoleSearch does without its summaries and blooms.
+umm
+benchScan(ConsoleFilter& filter, umm* results) {
+    std::lock_guard<std::mutex> guard(consoleLock);
+    LineBuffer& lines = console.lines;
+    u32 levelMask = filter.levels ? filter.levels : 0xffffffff;
+    umm needleLength = filter.text ? strlen(filter.text) : 0;
+    umm found = 0;
+    for (umm i = 0; i < lines.count && found < MAX_RESULTS; i++) {
+        umm slot = (lines.next + lines.max - 1 - i) % lines.max;
+        ConsoleLine& line = lines.data[slot];
+        if (!((1u << line.level) & levelMask)) continue;
+        if (filter.file && !strstr(consoleFiles.names[line.fileId], filter.file)) continue;
+        const char* text = (const char*)console.data + line.start;
+        if (filter.text && !consoleContains(text, line.size, filter.text, needleLength)) continue;
+        results[found++] = slot;
+    }
+    return found;
+}
+
+template<typename F>
+f64
+benchRun(umm* found, F search) {
+    umm results[MAX_RESULTS];
+    *found = search(results);
+    u64 start = clockNow();
+    for (u32 i = 0; i < REPEATS; i++) {
+        search(results);
+    }
+    return (f64)(clockNow() - start) / REPEATS;
+}
+
+void
+benchReport(const char* name, ConsoleFilter filter) {
+    umm found;
+    umm scanFound;
+    f64 indexed = benchRun(&found, [&](umm* results) {
+        return consoleSearch(console, filter, results, MAX_RESULTS);
+    });
+    f64 scan = benchRun(&scanFound, [&](umm* results) { return benchScan(filter, results); });
+    if (scanFound != found) printf("%s: the scan found %llu\n", name, (unsigned long long)scanFound);
+    printf("%-16s %6llu %12.1f us %12.1f us %8.1fx\n", name, (unsigned long long)found,
+           indexed / 1000, scan / 1000, scan / indexed);
+}
+
+int
+main(int argc, char** argv) {
+    umm lineCount = argc > 1 ? atoi(argv[1]) : 1000000;
+    clockCalibrateTsc();
+    console = initConsole(lineCount * 96, nullptr, lineCount);
+#ifdef WIN32
+    logFile = fopen("NUL", "w");
+#else
+    logFile = fopen("/dev/null", "w");
+#endif
+
+    for (umm i = 0; i < lineCount; i++) {
+        if (i % (lineCount / RARE_LINES) == lineCount / RARE_LINES / 2) {
+            log("WARN", "Vulkan/Present.cpp", 42, "rare warning %llu: swap chain out of date",
+                (unsigned long long)i);
+        } else {
+            log("INFO", "Renderer.cpp", 7, "frame %llu drew %llu meshes in %llu us",
+                (unsigned long long)i, (unsigned long long)(i % 300), (unsigned long long)(i % 4000));
+        }
+    }
+
+    printf("%llu lines in the scrollback, %u rare warnings\n",
+           (unsigned long long)console.lines.count, RARE_LINES);
+    printf("%-16s %6s %15s %15s %9s\n", "", "found", "consoleSearch", "scan", "speedup");
+    benchReport("level", {1u << LOG_LEVEL_WARN, nullptr, nullptr});
+    benchReport("file", {0, "Vulkan", nullptr});
+    benchReport("text", {0, nullptr, "out of date"});
+    benchReport("text, no match", {0, nullptr, "device lost"});
+    benchReport("common text", {0, nullptr, "meshes"});
+
+    logClose();
+}
@@ -0,0 +1,84 @@
+// NOTE(jan): Walks a large vertex array in an arena with and without
+// MEMORY_ARENA_HUGE_PAGES, once in order and once a page at a time in random
+// order, which is what stresses the TLB. The size in MiB can be passed as the
+// first argument.
+//
+//   g++ -std=c++17 -O2 -pthread bench/HugePages.cpp -o HugePages
+//   cl /std:c++17 /O2 /EHsc bench\HugePages.cpp
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../Memory.cpp"
+
+struct BenchVertex {
+    f32 position[3];
+    f32 normal[3];
+    f32 uv[2];
+};
+
+const umm BENCH_PAGE_SIZE = 4096;
+
+struct BenchResult {
+    f64 sequentialNs;
+    f64 randomNs;
+    f32 sum;
+};
+
+BenchResult
+benchTraverse(u32 flags, umm size, std::vector<u32>& pageOrder) {
+    MemoryArena arena = {};
+    arena.flags = flags;
+
+    umm count = size / sizeof(BenchVertex);
+    BenchVertex* vertices = memoryArenaAllocateArray(&arena, BenchVertex, count);
+    for (umm i = 0; i < count; i++) {
+        vertices[i] = {{(f32)i, 1, 2}, {0, 1, 0}, {0.5f, 0.5f}};
+    }
+
+    BenchResult result = {};
+
+    u64 start = clockNow();
+    for (umm i = 0; i < count; i++) {
+        result.sum += vertices[i].position[0] + vertices[i].normal[1];
+    }
+    result.sequentialNs = (f64)(clockNow() - start) / count;
+
+    // NOTE(jan): One vertex per page, pages in random order.
+    u8* bytes = (u8*)vertices;
+    umm pages = pageOrder.size();
+    start = clockNow();
+    for (u32 repeat = 0; repeat < 4; repeat++) {
+        for (umm i = 0; i < pages; i++) {
+            auto* vertex = (BenchVertex*)(bytes + (umm)pageOrder[i] * BENCH_PAGE_SIZE);
+            result.sum += vertex->position[0];
+        }
+    }
+    result.randomNs = (f64)(clockNow() - start) / (4 * pages);
+
+    memoryArenaClear(&arena);
+    return result;
+}
+
+int
+main(int argc, char** argv) {
+    umm size = (argc > 1 ? atoi(argv[1]) : 512) * 1024ull * 1024ull;
+    clockCalibrateTsc();
+
+    std::vector<u32> pageOrder(size / BENCH_PAGE_SIZE - 1);
+    for (umm i = 0; i < pageOrder.size(); i++) pageOrder[i] = (u32)i;
+    std::shuffle(pageOrder.begin(), pageOrder.end(), std::mt19937(1));
+
+    BenchResult normal = benchTraverse(0, size, pageOrder);
+    BenchResult huge = benchTraverse(MEMORY_ARENA_HUGE_PAGES, size, pageOrder);
+
+    printf("%llu MiB of vertices\n", (unsigned long long)(size >> 20));
+    printf("%12s %14s %14s\n", "", "sequential", "random page");
+    printf("%12s %11.2f ns %11.2f ns\n", "normal", normal.sequentialNs, normal.randomNs);
+    printf("%12s %11.2f ns %11.2f ns\n", "huge", huge.sequentialNs, huge.randomNs);
+    printf("huge page blocks %llu, fallbacks %llu (checksum %f)\n",
+           (unsigned long long)memoryHeapCounters.hugePageBlocks.load(),
+           (unsigned long long)memoryHeapCounters.hugePageFallbacks.load(),
+           normal.sum + huge.sum);
+}
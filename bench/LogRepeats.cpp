@@ -0,0 +1,105 @@
+// NOTE(jan): A storm of repeated warnings from one call site and through
+// LOG_KEYED, with rate limiting on and with it turned off, from one and from
+// four threads. Checks that the dropped and written lines add up to the
+// lines logged.
+//
+//   g++ -std=c++17 -O2 -pthread bench/LogRepeats.cpp -o LogRepeats
+//   cl /std:c++17 /O2 /EHsc bench\LogRepeats.cpp
+
+#include <thread>
+#include <vector>
+
+// NOTE(jan): Memory.cpp brings in Logging.cpp and the arena it allocates from.
+#include "../Memory.cpp"
+
+const u32 LINES = 1000000;
+
+template<typename F>
+f64
+benchLines(u32 threadCount, u32 lines, F work) {
+    std::vector<std::thread> threads;
+    u64 start = clockNow();
+    for (u32 t = 0; t < threadCount; t++) {
+        threads.emplace_back(work, lines / threadCount);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return (f64)(clockNow() - start) / lines;
+}
+
+void
+benchSite(u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        WARN("descriptor set %u is not bound", i);
+    }
+}
+
+void
+benchKeyed(u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        LOG_KEYED(LOG_LEVEL_WARN, "WARNING", 42, "descriptor set is not bound",
+                  "[validation] descriptor set %u is not bound", i);
+    }
+}
+
+// NOTE(jan): Sums the counts in the "xN in last T ms" lines since offset.
+u64
+benchDropped(const char* path, long offset) {
+    FILE* file = fopen(path, "r");
+    fseek(file, offset, SEEK_SET);
+    char line[512];
+    u64 result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        const char* x = strstr(line, "] x");
+        unsigned long long count;
+        if (x && sscanf(x, "] x%llu in last", &count) == 1) result += count;
+    }
+    fclose(file);
+    return result;
+}
+
+u64
+benchWritten(const char* path, long offset) {
+    FILE* file = fopen(path, "r");
+    fseek(file, offset, SEEK_SET);
+    char line[512];
+    u64 result = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (strstr(line, "is not bound") && !strstr(line, "] x")) result++;
+    }
+    fclose(file);
+    return result;
+}
+
+void
+benchReport(const char* path, const char* name, u32 threadCount, void (*work)(u32)) {
+    long offset = ftell(logFile);
+    f64 ns = benchLines(threadCount, LINES, work);
+    logRepeatsReport();
+    fflush(logFile);
+    u64 written = benchWritten(path, offset);
+    u64 dropped = benchDropped(path, offset);
+    printf("%-22s %9.1f ns %10llu %10llu %s\n", name, ns, (unsigned long long)written,
+           (unsigned long long)dropped, written + dropped == LINES ? "" : "(lines missing)");
+}
+
+int
+main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "LogRepeats.log";
+    clockCalibrateTsc();
+    console = initConsole(4 * 1024 * 1024);
+    logFile = fopen(path, "w");
+
+    printf("%u lines per run, burst %u, %u per second\n", LINES, logRate.burst, logRate.perSecond);
+    printf("%-22s %12s %10s %10s\n", "", "per line", "written", "dropped");
+    benchReport(path, "call site", 1, benchSite);
+    benchReport(path, "call site, 4 threads", 4, benchSite);
+    benchReport(path, "keyed", 1, benchKeyed);
+    benchReport(path, "keyed, 4 threads", 4, benchKeyed);
+
+    logRate.perSecond = 0;
+    benchReport(path, "unlimited", 1, benchSite);
+
+    logClose();
+}
@@ -0,0 +1,77 @@
+// NOTE(jan): Log throughput through the console ring of whichever backend it
+// is built on, written to a file synchronously, through the writer thread and
+// into a mapped file, from one and from four threads. Build with -DLOG_BINARY
+// to time binary records instead. The output file can be passed as the first
+// argument.
+//
+//   g++ -std=c++17 -O2 -pthread bench/LogThroughput.cpp -o LogThroughput
+//   cl /std:c++17 /O2 /EHsc bench\LogThroughput.cpp
+
+#include <thread>
+#include <vector>
+
+// NOTE(jan): Memory.cpp brings in Logging.cpp and the arena it allocates from.
+#include "../Memory.cpp"
+
+const u32 LINES = 200000;
+
+template<typename F>
+f64
+benchLines(u32 threadCount, F work) {
+    std::vector<std::thread> threads;
+    u64 start = clockNow();
+    for (u32 t = 0; t < threadCount; t++) {
+        threads.emplace_back(work, t, LINES / threadCount);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    logFlush();
+    return (f64)(clockNow() - start) / LINES;
+}
+
+void
+benchLog(u32 thread, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        INFO("thread %u line %u of the log throughput benchmark", thread, i);
+    }
+}
+
+int
+main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "LogThroughput.log";
+    clockCalibrateTsc();
+    console = initConsole(4 * 1024 * 1024);
+
+#ifdef WIN32
+    const char* backend = "Win32";
+#else
+    const char* backend = "POSIX";
+#endif
+#ifdef LOG_BINARY
+    const char* mode = "binary";
+#else
+    const char* mode = "text";
+#endif
+    printf("%s console, %s lines, %u lines per run\n", backend, mode, LINES);
+    printf("%-18s %12s %12s\n", "", "1 thread", "4 threads");
+
+    logFile = fopen(path, "w");
+    f64 sync1 = benchLines(1, benchLog);
+    f64 sync4 = benchLines(4, benchLog);
+    printf("%-18s %9.0f ns %9.0f ns\n", "fflush per line", sync1, sync4);
+
+    logWriterStart(logFile);
+    f64 writer1 = benchLines(1, benchLog);
+    f64 writer4 = benchLines(4, benchLog);
+    printf("%-18s %9.0f ns %9.0f ns\n", "writer thread", writer1, writer4);
+    logClose();
+
+    if (logMapOpen(path)) {
+        logWriterStart(nullptr);
+        f64 mapped1 = benchLines(1, benchLog);
+        f64 mapped4 = benchLines(4, benchLog);
+        printf("%-18s %9.0f ns %9.0f ns\n", "mapped + writer", mapped1, mapped4);
+        logClose();
+    }
+}
@@ -0,0 +1,108 @@
+// NOTE(jan): Synchronous log lines written to a mapped file against fwrite
+// with an fflush per line, from one and from four threads. On POSIX a child
+// then logs through the writer thread into a mapped file and is killed, and
+// the lines the header says were committed are counted. The output file can
+// be passed as the first argument.
+//
+//   g++ -std=c++17 -O2 -pthread bench/MappedLog.cpp -o MappedLog
+//   cl /std:c++17 /O2 /EHsc bench\MappedLog.cpp
+
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+// NOTE(jan): Memory.cpp brings in Logging.cpp and the arena it allocates from.
+#include "../Memory.cpp"
+
+const u32 LINES = 200000;
+const u32 KILLED_LINES = 100000;
+
+template<typename F>
+f64
+benchLines(u32 threadCount, F work) {
+    std::vector<std::thread> threads;
+    u64 start = clockNow();
+    for (u32 t = 0; t < threadCount; t++) {
+        threads.emplace_back(work, t, LINES / threadCount);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return (f64)(clockNow() - start) / LINES;
+}
+
+void
+benchLog(u32 thread, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        INFO("thread %u line %u of the mapped log benchmark", thread, i);
+    }
+}
+
+#ifndef WIN32
+// NOTE(jan): Returns the number of whole lines in the committed text, or -1 if
+// the file is not a mapped log.
+s64
+benchCommittedLines(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+    LogFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+            memcmp(header.magic, LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC)) != 0) {
+        fclose(file);
+        return -1;
+    }
+    u64 committed = header.committed.load();
+    s64 result = 0;
+    for (u64 i = 0; i < committed; i++) {
+        int c = fgetc(file);
+        if (c == EOF) break;
+        if (c == '\n') result++;
+    }
+    fclose(file);
+    return result;
+}
+#endif
+
+int
+main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "MappedLog.log";
+    clockCalibrateTsc();
+    console = initConsole(4 * 1024 * 1024);
+
+    printf("%u lines per run\n", LINES);
+    printf("%-18s %12s %12s\n", "", "1 thread", "4 threads");
+
+    logFile = fopen(path, "w");
+    f64 flushed1 = benchLines(1, benchLog);
+    f64 flushed4 = benchLines(4, benchLog);
+    printf("%-18s %9.0f ns %9.0f ns\n", "fflush per line", flushed1, flushed4);
+    logClose();
+
+    if (!logMapOpen(path, 1024 * 1024)) {
+        printf("could not map %s\n", path);
+        return 1;
+    }
+    f64 mapped1 = benchLines(1, benchLog);
+    f64 mapped4 = benchLines(4, benchLog);
+    printf("%-18s %9.0f ns %9.0f ns\n", "mapped", mapped1, mapped4);
+    logClose();
+
+#ifndef WIN32
+    pid_t child = fork();
+    if (child == 0) {
+        logMapOpen(path, 1024 * 1024);
+        logWriterStart(nullptr);
+        benchLog(0, KILLED_LINES);
+        logFlush();
+        raise(SIGKILL);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    printf("killed child: %lld of %u lines committed\n",
+           (long long)benchCommittedLines(path), KILLED_LINES);
+#endif
+}
@@ -0,0 +1,118 @@
+// NOTE(jan): String view kernels against the std::string calls they replace,
+// on a 4 MiB text and on short names. Build with -mavx2, or with
+// -DSTRING_NO_SIMD for the scalar reference paths.
+//
+//   g++ -std=c++17 -O2 -pthread bench/StringOps.cpp -o StringOps
+//   cl /std:c++17 /O2 /EHsc bench\StringOps.cpp
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../String.cpp"
+
+const umm TEXT_SIZE = 4 * 1024 * 1024;
+const u32 SHORT_REPEATS = 1000000;
+
+// NOTE(jan): Keeps results alive so the compiler cannot drop the work.
+volatile u64 benchSink;
+
+template<typename F>
+f64
+benchRun(u32 repeats, F work) {
+    u64 start = clockNow();
+    for (u32 i = 0; i < repeats; i++) {
+        benchSink = benchSink + work();
+    }
+    return (f64)(clockNow() - start) / repeats;
+}
+
+void
+benchReport(const char* name, f64 viewNs, f64 stdNs) {
+    printf("%-24s %12.1f ns %12.1f ns %8.2fx\n", name, viewNs, stdNs, stdNs / viewNs);
+}
+
+bool
+stdEqualsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return asciiToLower(x) == asciiToLower(y);
+    });
+}
+
+int
+main() {
+    MemoryArena arena = {};
+    std::mt19937 random(1);
+    const char* words[] = {"vertex", "fragment", "sampler", "uniform", "descriptor", "pipeline"};
+
+    std::string text;
+    while (text.size() < TEXT_SIZE) {
+        text += words[random() % 6];
+        text += (random() % 8 == 0) ? '\n' : ' ';
+    }
+    text += "needle";
+    String view = stringView(text.data(), text.size());
+
+    printf("%-24s %15s %15s %9s\n", "", "String", "std::string", "speedup");
+
+    benchReport("find char",
+        benchRun(20, [&] { return (u64)stringFindChar(view, '#'); }),
+        benchRun(20, [&] { return (u64)text.find('#'); }));
+
+    benchReport("find substring",
+        benchRun(20, [&] { return (u64)stringFind(view, "needle"); }),
+        benchRun(20, [&] { return (u64)text.find("needle"); }));
+
+    benchReport("split lines",
+        benchRun(10, [&] {
+            MemoryArenaScope scope(&arena);
+            return (u64)stringSplit(&arena, view, '\n').count;
+        }),
+        benchRun(10, [&] {
+            std::vector<std::string> lines;
+            umm start = 0;
+            umm end;
+            while ((end = text.find('\n', start)) != std::string::npos) {
+                lines.push_back(text.substr(start, end - start));
+                start = end + 1;
+            }
+            lines.push_back(text.substr(start));
+            return (u64)lines.size();
+        }));
+
+    benchReport("hash text",
+        benchRun(20, [&] { return stringHash(view); }),
+        benchRun(20, [&] { return (u64)std::hash<std::string>()(text); }));
+
+    std::string name = "  VK_LAYER_KHRONOS_validation  ";
+    std::string other = "vk_layer_khronos_VALIDATION";
+    String nameView = stringView(name.data(), name.size());
+    String otherView = stringView(other.data(), other.size());
+
+    benchReport("trim",
+        benchRun(SHORT_REPEATS, [&] { return (u64)stringTrim(nameView).length; }),
+        benchRun(SHORT_REPEATS, [&] {
+            umm first = name.find_first_not_of(' ');
+            umm last = name.find_last_not_of(' ');
+            return (u64)name.substr(first, last - first + 1).size();
+        }));
+
+    String trimmed = stringTrim(nameView);
+    std::string trimmedStd(trimmed.data, trimmed.length);
+
+    benchReport("starts with",
+        benchRun(SHORT_REPEATS, [&] { return (u64)stringStartsWith(trimmed, stringLiteral("VK_LAYER")); }),
+        benchRun(SHORT_REPEATS, [&] { return (u64)(trimmedStd.rfind("VK_LAYER", 0) == 0); }));
+
+    benchReport("equals ignore case",
+        benchRun(SHORT_REPEATS, [&] { return (u64)stringEqualsIgnoreCase(trimmed, otherView); }),
+        benchRun(SHORT_REPEATS, [&] { return (u64)stdEqualsIgnoreCase(trimmedStd, other); }));
+
+    benchReport("hash name",
+        benchRun(SHORT_REPEATS, [&] { return stringHash(trimmed); }),
+        benchRun(SHORT_REPEATS, [&] { return (u64)std::hash<std::string>()(trimmedStd); }));
+
+    memoryArenaClear(&arena);
+}